@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////
+/// Micro-benchmark of the inner loops built on Algebra.h.
+/// Every loop is timed twice: as the compiler leaves it and
+/// as a twin with auto-vectorization turned off. The ratio
+/// is what vectorizing is worth on this machine, not proof
+/// that it happened: a loop of Vec3 structs may vectorize
+/// and still lose to its twin on the shuffles, or stay
+/// scalar and tie. Only the compiler's report says which
+/// loops were vectorized. Build with optimizations on, e.g.
+///   g++ -O3 -std=c++14 -Isrc bench/AlgebraBench.cpp
+/// and add -fopt-info-vec (GCC), -Rpass=loop-vectorize
+/// (clang) or /Qvec-report:2 (MSVC) to see it.
+////////////////////////////////////////////////////////////
+#include "Algebra.h"
+#include <stdio.h>              /* printf */
+#include <stdlib.h>             /* atoi */
+#include <vector>
+#include <chrono>               /* steady_clock */
+
+#if defined(_MSC_VER)
+#define SCALAR_FUNC
+#define SCALAR_LOOP __pragma(loop(no_vector))
+#elif defined(__clang__)
+#define SCALAR_FUNC
+#define SCALAR_LOOP _Pragma("clang loop vectorize(disable) interleave(disable)")
+#else
+#define SCALAR_FUNC __attribute__((optimize("no-tree-vectorize", "no-tree-slp-vectorize")))
+#define SCALAR_LOOP
+#endif
+
+/* each loop and its scalar twin share one body */
+#define BENCH_PAIR(name, params, ...)                                   \
+    static void name params { for (size_t i = 0; i < n; ++i) { __VA_ARGS__; } } \
+    SCALAR_FUNC static void name##Scalar params { SCALAR_LOOP for (size_t i = 0; i < n; ++i) { __VA_ARGS__; } }
+
+BENCH_PAIR(dots, (const Vec3r* a, const Vec3r* b, Real* out, const size_t n),
+    out[i] = a[i].dot(b[i]))
+BENCH_PAIR(units, (const Vec3r* a, const Vec3r* /*b*/, Vec3r* out, const size_t n),
+    out[i] = a[i].unit())
+BENCH_PAIR(crosses, (const Vec3r* a, const Vec3r* b, Vec3r* out, const size_t n),
+    out[i] = (a[i] * b[i]).blend(b[i]) + a[i])
+
+////////////////////////////////////////////////////////////
+/// Discriminant of one ray against many spheres, the part
+/// of Sphere::intersect the BVH leaves repeat most, in the
+/// same half b form: the direction is of unit length, so
+/// the quadratic's a is 1 and b is halved.
+////////////////////////////////////////////////////////////
+BENCH_PAIR(spheres, (const Vec3r* centres, const Vec3r* d, Real* out, const size_t n),
+    const Vec3r o(Vec3r(1, 2, 3) - centres[i]);
+    const Real b = d->dot(o), c = o.dot(o) - 4;
+    out[i] = b * b - c)
+
+////////////////////////////////////////////////////////////
+/// Times rounds of a loop.
+///
+/// RETURNS: nanoseconds per element of the best round.
+////////////////////////////////////////////////////////////
+template <class F>
+static double measure(const F& f, const size_t n, const int rounds)
+{
+    double best = 1e300;
+    for (int r = 0; r < rounds; ++r)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        f();
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t n = argc > 1 ? (size_t)atoi(argv[1]) : 4096;      /* fits in L1/L2, so compute bound */
+    const int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+    std::vector<Vec3r> a(n), b(n), v(n);
+    std::vector<Real> s(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        a[i] = Vec3r(Real(i % 7 + 1), Real(i % 5) - 2, Real(i % 3) + Real(0.5));
+        b[i] = Vec3r(Real(i % 11) - 5, Real(i % 13 + 1), Real(i % 2) - Real(0.25));
+    }
+    b[0] = b[0].unit();                                             /* the ray of spheres */
+
+    printf("%-10s %12s %12s %8s\n", "loop", "ns/elem", "scalar", "speedup");
+#define BENCH_ROW(name, out)                                                            \
+    {                                                                                   \
+        const double fast = measure([&]() { name(a.data(), b.data(), out, n); }, n, rounds), \
+            slow = measure([&]() { name##Scalar(a.data(), b.data(), out, n); }, n, rounds); \
+        printf("%-10s %12.3f %12.3f %8.2f\n", #name, fast, slow, slow / fast);          \
+    }
+    BENCH_ROW(dots, s.data())
+    BENCH_ROW(units, v.data())
+    BENCH_ROW(crosses, v.data())
+    BENCH_ROW(spheres, s.data())
+
+    Real sum = 0;                                                   /* keep the results alive */
+    for (size_t i = 0; i < n; ++i)
+        sum += s[i] + v[i].x;
+    printf("checksum %g\n", double(sum));
+    return 0;
+}
@@ -0,0 +1,341 @@
+////////////////////////////////////////////////////////////
+/// Micro-benchmark of the kernels a frame spends its time
+/// in: ray against sphere, polygon and triangle, the SIMD
+/// sphere runs at every level the CPU has, the shading of
+/// Scene::illuminate and the vector operators.
+///
+/// Inputs are random but seeded, drawn from SceneRandom,
+/// so two builds time the same rays whatever standard
+/// library they use. Ray cases set how rays meet their
+/// targets: all hit, all miss, half and half, or graze the
+/// outline (spheres) or the plane (polygons, triangles).
+/// An op is one ray, but for sphere_run64, which times each
+/// ray against a run of 64 spheres, one sphere test. Results
+/// are one row per kernel and case, as CSV or with --json
+/// as JSON, to be diffed across commits:
+///   KernelBench [--seed n] [--rounds n] [--json]
+////////////////////////////////////////////////////////////
+#include "Trace.h"
+#include "Primitives.h"         /* triangleHit */
+#include "Spheres.h"
+#include "SceneGen.h"           /* SceneRandom */
+#include <stdio.h>              /* printf */
+#include <stdlib.h>             /* atoi */
+#include <string.h>             /* strcmp */
+#include <math.h>               /* sqrt, sin, cos */
+#include <utility>              /* swap */
+#include <string>
+#include <vector>
+#include <chrono>               /* steady_clock */
+
+#define BENCH_RAYS 4096         /* per case, with the targets they fit in L1/L2 */
+#define BENCH_TARGETS 64
+
+struct Result
+{
+    std::string kernel, variant, simd;
+    double ns;                  // per op, best round
+    double hitRate;             // of the rays, -1 for kernels without rays
+};
+
+enum Case { AllHit, AllMiss, Mixed, Grazing };
+static const char* caseNames[] = { "hit", "miss", "mixed", "grazing" };
+
+static SceneRandom rng(1);
+
+static Real uniform(const double a, const double b)
+{
+    return rng.uniform(a, b);
+}
+
+static Vec3r direction()
+{
+    for (;;)
+    {
+        const Vec3r v(rng.box(Vec3r(-1, -1, -1), Vec3r(1, 1, 1)));
+        const Real l = v.dot(v);
+        if (l > Real(1e-4) && l <= 1) return v * (1 / sqrt(l));
+    }
+}
+
+/* fraction of the target's size a ray passes the centre at */
+static Real offset(const Case c)
+{
+    switch (c)
+    {
+    case AllHit: return uniform(0, 0.9);
+    case AllMiss: return uniform(1.1, 2);
+    case Mixed: return rng.next() & 1 ? uniform(0, 0.9) : uniform(1.1, 2);
+    default: return uniform(0.98, 1.02);
+    }
+}
+
+template <class F>
+static double measure(const F& f, const size_t n, const int rounds)
+{
+    double best = 1e300;
+    for (int r = 0; r < rounds; ++r)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        f();
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+////////////////////////////////////////////////////////////
+/// Rays from outside a sphere of the given centre and
+/// radius, aimed past its centre at the case's offset.
+////////////////////////////////////////////////////////////
+static Ray sphereRay(const Vec3r& centre, const Real radius, const Case c)
+{
+    const Vec3r u(direction());
+    Vec3r w(u * direction());                               /* across the line of sight */
+    w = w * (1 / sqrt(w.dot(w)));
+    const Vec3r from(centre + u * (10 * radius));
+    return Ray(from, Vec3r(from, centre + w * (offset(c) * radius)));
+}
+
+////////////////////////////////////////////////////////////
+/// Rays at a square of half edge size around centre, in
+/// the plane z = centre.z: steep for most cases, within a few
+/// degrees of the plane when grazing. Hits land inside the
+/// triangle (-1,-1) (1,-1) (-1,1) of the square as well.
+////////////////////////////////////////////////////////////
+static Ray planeRay(const Vec3r& centre, const Real size, const Case c)
+{
+    const Real pi = Real(3.14159265358979);
+    const bool inside = c == AllHit || c == Grazing || (c == Mixed && (rng.next() & 1));
+    Real x, y;
+    if (inside)
+        do
+        {
+            x = uniform(-0.9, 0.9);
+            y = uniform(-0.9, 0.9);
+        } while (x + y > 0);
+    else
+    {
+        x = uniform(1.1, 2);
+        if (rng.next() & 1) x = -x;
+        y = uniform(-2, 2);
+        if (rng.next() & 1) std::swap(x, y);
+    }
+    const Real elevation = c == Grazing ? uniform(1, 5) * pi / 180 : uniform(30, 90) * pi / 180,
+        heading = uniform(0, 2 * pi), side = rng.next() & 1 ? Real(1) : Real(-1);
+    const Vec3r target(centre + Vec3r(x * size, y * size, 0));
+    const Vec3r from(target + Vec3r(cos(elevation) * cos(heading), cos(elevation) * sin(heading), side * sin(elevation)) * (10 * size));
+    return Ray(from, Vec3r(from, target));
+}
+
+static Vec3r spot()
+{
+    return rng.box(Vec3r(-100, -100, -100), Vec3r(100, 100, 100));
+}
+
+static void rayKernels(std::vector<Result>& results, const int rounds)
+{
+    std::vector<Sphere> spheres(BENCH_TARGETS);
+    std::vector<TPolygon> polygons(BENCH_TARGETS);
+    std::vector<Vec3r> corners(3 * BENCH_TARGETS);
+    std::vector<Real> sizes(BENCH_TARGETS);
+    for (size_t i = 0; i < BENCH_TARGETS; ++i)
+    {
+        spheres[i].centre = spot();
+        spheres[i].radius = uniform(1, 20);
+        const Vec3r c(spot());
+        const Real s = sizes[i] = uniform(1, 20);
+        const Vec3r square[] = { Vec3r(-s, -s, 0), Vec3r(s, -s, 0), Vec3r(s, s, 0), Vec3r(-s, s, 0), Vec3r(-s, -s, 0) };
+        for (const Vec3r& v : square)
+            polygons[i].vertices.push_back(c + v);
+        polygons[i].init();
+        corners[3 * i] = c + square[0];
+        corners[3 * i + 1] = c + square[1];
+        corners[3 * i + 2] = c + square[3];
+    }
+
+    SphereSoA soa;
+    soa.resize(BENCH_TARGETS);
+    for (size_t i = 0; i < BENCH_TARGETS; ++i)
+        soa.set(i, spheres[i].centre, spheres[i].radius);
+
+    std::vector<Ray> rays(BENCH_RAYS);
+    std::vector<Real> t(BENCH_RAYS);
+    const auto hitRate = [&]()
+    {
+        size_t hits = 0;
+        for (const Real d : t)
+            hits += d > 0;
+        return double(hits) / BENCH_RAYS;
+    };
+    for (int c = AllHit; c <= Grazing; ++c)
+    {
+        for (size_t i = 0; i < BENCH_RAYS; ++i)
+            rays[i] = sphereRay(spheres[i % BENCH_TARGETS].centre, spheres[i % BENCH_TARGETS].radius, Case(c));
+        const double sphere = measure([&]()
+        {
+            for (size_t i = 0; i < BENCH_RAYS; ++i)
+                t[i] = spheres[i % BENCH_TARGETS].intersect(rays[i]);
+        }, BENCH_RAYS, rounds);
+        results.push_back({ "sphere", caseNames[c], "scalar", sphere, hitRate() });
+
+        /* every ray against the whole run, at each level the CPU has */
+        for (int level = SimdScalar; level <= SimdAVX512; ++level)
+        {
+            soa.select(SimdLevel(level));
+            if (soa.level() != level) continue;
+            const double run = measure([&]()
+            {
+                for (size_t i = 0; i < BENCH_RAYS; ++i)
+                {
+                    Real d = rays[i].tmax;
+                    t[i] = soa.closest(SphereQuery(rays[i]), SphereSoA::none, 0, BENCH_TARGETS, d) == SphereSoA::none ? -1 : d;
+                }
+            }, BENCH_RAYS * BENCH_TARGETS, rounds);
+            static const char* levels[] = { "scalar", "sse2", "avx2", "avx512" };
+            results.push_back({ "sphere_run64", caseNames[c], levels[level], run, hitRate() });
+        }
+
+        for (size_t i = 0; i < BENCH_RAYS; ++i)
+        {
+            const size_t k = i % BENCH_TARGETS;
+            rays[i] = planeRay(polygons[k].vertices[0] + Vec3r(sizes[k], sizes[k], 0), sizes[k], Case(c));
+        }
+        const double polygon = measure([&]()
+        {
+            for (size_t i = 0; i < BENCH_RAYS; ++i)
+                t[i] = polygons[i % BENCH_TARGETS].intersect(rays[i]);
+        }, BENCH_RAYS, rounds);
+        results.push_back({ "polygon", caseNames[c], "scalar", polygon, hitRate() });
+        const double triangle = measure([&]()
+        {
+            for (size_t i = 0; i < BENCH_RAYS; ++i)
+            {
+                const Vec3r* v = &corners[3 * (i % BENCH_TARGETS)];
+                t[i] = triangleHit(v[0], v[1], v[2], rays[i]);
+            }
+        }, BENCH_RAYS, rounds);
+        results.push_back({ "triangle", caseNames[c], "scalar", triangle, hitRate() });
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Shading one point by one light, either lit from the
+/// side of its normal or from anywhere, when about half
+/// the lights are behind the surface and skipped early.
+////////////////////////////////////////////////////////////
+static void shadingKernels(std::vector<Result>& results, const int rounds)
+{
+    Scene scene;
+    std::vector<PointLight> lights(BENCH_TARGETS);
+    std::vector<Material> materials(BENCH_TARGETS);
+    for (size_t i = 0; i < BENCH_TARGETS; ++i)
+    {
+        lights[i].centre = spot();
+        lights[i].intensity = rng.box(Vec3r(0, 0, 0), Vec3r(1, 1, 1));
+        Material& m = materials[i];
+        m.ambient = rng.box(Vec3r(0, 0, 0), Vec3r(1, 1, 1));
+        m.diffuse = rng.box(Vec3r(0, 0, 0), Vec3r(1, 1, 1));
+        m.specular = uniform(0, 1);
+        m.exponent = Real(int(uniform(1, 60)));
+        m.reflect = uniform(0, 0.5);
+    }
+    std::vector<Vec3r> normals(BENCH_RAYS), points(BENCH_RAYS), light(BENCH_RAYS);
+    const Vec3r viewer(0, 0, 500);
+    static const char* variants[] = { "facing", "any" };
+    for (int v = 0; v < 2; ++v)
+    {
+        for (size_t i = 0; i < BENCH_RAYS; ++i)
+        {
+            points[i] = spot();
+            normals[i] = direction();
+            const Vec3r toLight(lights[i % BENCH_TARGETS].centre - points[i]);
+            if (!v && normals[i].dot(toLight) < 0) normals[i] = normals[i] * -1;
+        }
+        const double ns = measure([&]()
+        {
+            for (size_t i = 0; i < BENCH_RAYS; ++i)
+            {
+                light[i].zero();
+                scene.illuminate(light[i], &lights[i % BENCH_TARGETS], materials[i % BENCH_TARGETS], normals[i], points[i], viewer);
+            }
+        }, BENCH_RAYS, rounds);
+        results.push_back({ "illuminate", variants[v], "scalar", ns, -1 });
+    }
+}
+
+static void vectorKernels(std::vector<Result>& results, const int rounds)
+{
+    std::vector<Vec3r> a(BENCH_RAYS), b(BENCH_RAYS), v(BENCH_RAYS);
+    std::vector<Real> s(BENCH_RAYS);
+    for (size_t i = 0; i < BENCH_RAYS; ++i)
+    {
+        a[i] = spot();
+        b[i] = spot();
+    }
+#define VECTOR_ROW(name, body)                                                  \
+    results.push_back({ "vector", name, "scalar", measure([&]()                  \
+    {                                                                           \
+        for (size_t i = 0; i < BENCH_RAYS; ++i) { body; }                       \
+    }, BENCH_RAYS, rounds), -1 })
+    VECTOR_ROW("dot", s[i] = a[i].dot(b[i]));
+    VECTOR_ROW("cross", v[i] = a[i] * b[i]);
+    VECTOR_ROW("unit", v[i] = a[i].unit());
+    VECTOR_ROW("blend", v[i] = a[i].blend(b[i]));
+    VECTOR_ROW("add_scale", v[i] = a[i] + b[i] * Real(0.5));
+#undef VECTOR_ROW
+    Real sum = 0;                                           /* keep the results alive */
+    for (size_t i = 0; i < BENCH_RAYS; ++i)
+        sum += s[i] + v[i].x;
+    if (sum == Real(0.125)) printf("#");
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int seed = 1;
+    int rounds = 200;
+    bool json = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--json")) json = true;
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned int)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) rounds = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: KernelBench [--seed n] [--rounds n] [--json]\n");
+            return 2;
+        }
+    }
+    rng = SceneRandom(seed);
+
+    std::vector<Result> results;
+    rayKernels(results, rounds);
+    shadingKernels(results, rounds);
+    vectorKernels(results, rounds);
+
+    const char* real = sizeof(Real) == sizeof(float) ? "float" : "double";
+    if (json)
+    {
+        printf("{\"seed\": %u, \"rounds\": %d, \"real\": \"%s\", \"results\": [\n", seed, rounds, real);
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            printf("  {\"kernel\": \"%s\", \"case\": \"%s\", \"simd\": \"%s\", \"ns_per_op\": %.4f, \"mops_per_s\": %.3f",
+                r.kernel.c_str(), r.variant.c_str(), r.simd.c_str(), r.ns, 1e3 / r.ns);
+            if (r.hitRate >= 0) printf(", \"hit_rate\": %.4f", r.hitRate);
+            printf("}%s\n", i + 1 < results.size() ? "," : "");
+        }
+        printf("]}\n");
+    }
+    else
+    {
+        printf("kernel,case,simd,real,ns_per_op,mops_per_s,hit_rate\n");
+        for (const Result& r : results)
+        {
+            printf("%s,%s,%s,%s,%.4f,%.3f,", r.kernel.c_str(), r.variant.c_str(), r.simd.c_str(), real, r.ns, 1e3 / r.ns);
+            if (r.hitRate >= 0) printf("%.4f", r.hitRate);
+            printf("\n");
+        }
+    }
+    return 0;
+}
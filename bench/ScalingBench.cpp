@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////
+/// End to end benchmark of Renderer::capture. Renders every
+/// combination of the listed scene sizes, light counts,
+/// depths, resolutions and thread counts and prints one row
+/// per frame as CSV, or with --json as JSON:
+///   ScalingBench [--prims 10,1000,...] [--lights 1,...]
+///                [--depths 5,...] [--res 512,...]
+///                [--threads 1,2,...] [--layout field]
+///                [--seed n] [--json]
+///
+/// By default it sweeps sizes 10 to 1000000, lights 1 to
+/// 1000, depths 1, 5 and 10 and resolutions 256 to 1024,
+/// on 1, 2, 4 ... up to the hardware threads, which takes
+/// long; narrow the lists for a quick run.
+///
+/// Scenes come from generateScene, spheres in a field by
+/// default, seen in full at every resolution. The BVH is
+/// built once per size; lights, depth, resolution and
+/// threads only change the capture.
+///
+/// Columns: paths are primary rays; rays are paths plus
+/// their reflections and the shadow rays of every shaded
+/// point, which are only counted without RTR_NO_STATS.
+/// Efficiency is the speedup over the one thread run of the
+/// same frame divided by the threads, when 1 is among them.
+/// Peak RSS is of the whole process so far, so sizes are
+/// run in increasing order.
+////////////////////////////////////////////////////////////
+#include "Trace.h"
+#include "SceneGen.h"
+#include <stdio.h>              /* printf */
+#include <stdlib.h>             /* strtoul */
+#include <string.h>             /* strcmp */
+#include <algorithm>            /* sort, unique */
+#include <string>               /* to_string */
+#include <vector>
+#include <thread>               /* hardware_concurrency */
+#include <chrono>               /* steady_clock */
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>              /* GetProcessMemoryInfo */
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>       /* getrusage */
+#endif
+
+/* peak resident set of the process, in MB */
+static double peakRss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);     /* bytes */
+#else
+    return usage.ru_maxrss / 1024.0;                /* kilobytes */
+#endif
+#endif
+}
+
+static std::vector<size_t> parseList(const char* s)
+{
+    std::vector<size_t> values;
+    for (char* end; *s; s = *end ? end + 1 : end)
+    {
+        values.push_back((size_t)strtoul(s, &end, 10));
+        if (end == s) return std::vector<size_t>();
+    }
+    return values;
+}
+
+struct Row
+{
+    size_t prims, lights, depth, res, threads;
+    double buildMs, renderMs, mpaths, mrays, efficiency, rssMb;
+};
+
+int main(int argc, char** argv)
+{
+    std::vector<size_t> prims = { 10, 1000, 100000, 1000000 }, lights = { 1, 10, 100, 1000 }, depths = { 1, 5, 10 },
+        res = { 256, 512, 1024 }, threads;
+    for (size_t t = 1; t < std::thread::hardware_concurrency(); t *= 2)
+        threads.push_back(t);
+    threads.push_back(std::max(1u, std::thread::hardware_concurrency()));
+    threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+    SceneSpec spec;
+    bool json = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* a = argv[i];
+        std::vector<size_t>* list = !strcmp(a, "--prims") ? &prims : !strcmp(a, "--lights") ? &lights :
+            !strcmp(a, "--depths") ? &depths : !strcmp(a, "--res") ? &res : !strcmp(a, "--threads") ? &threads : nullptr;
+        if (!strcmp(a, "--json"))
+            json = true;
+        else if (!strcmp(a, "--seed") && i + 1 < argc)
+            spec.seed = strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(a, "--layout") && i + 1 < argc && parseLayout(argv[i + 1], spec.layout))
+            ++i;
+        else if (!list || i + 1 == argc || (*list = parseList(argv[++i])).empty())
+        {
+            fprintf(stderr, "usage: ScalingBench [--prims a,b] [--lights a,b] [--depths a,b] [--res a,b] [--threads a,b] [--layout name] [--seed n] [--json]\n");
+            return 2;
+        }
+    }
+    std::sort(prims.begin(), prims.end());
+
+    size_t printed = 0;
+    if (json)
+        printf("{\"layout\": \"%s\", \"seed\": %llu, \"real\": \"%s\", \"results\": [\n", layoutName(spec.layout), spec.seed,
+            sizeof(Real) == sizeof(float) ? "float" : "double");
+    else
+        printf("prims,lights,depth,width,height,threads,build_ms,render_ms,mpaths_per_s,mrays_per_s,efficiency,peak_rss_mb\n");
+    for (const size_t p : prims)
+    {
+        Renderer renderer;
+        spec.prims = p;
+        spec.lights = 0;
+        generateScene(renderer, spec);
+        auto started = std::chrono::steady_clock::now();
+        renderer.init();
+        const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        for (const size_t l : lights)
+        {
+            Renderer array;                             /* lights only, swapped in */
+            SceneSpec lit = spec;
+            lit.prims = 0;
+            lit.lights = l;
+            generateScene(array, lit);
+            renderer.scene->point_lights = array.scene->point_lights;
+            for (const size_t d : depths)
+                for (const size_t r : res)
+                {
+                    const Real pixel = Real(600.0 / r);         /* the view of a 600 pixel frame at any resolution */
+                    renderer.cameras[0]->set(Vec3r(0, 0, 500), Vec3r(0, 0, 0), Vec3r(pixel, 0, 0), Vec3r(0, pixel, 0));
+                    double single = 0;
+                    for (const size_t t : threads)
+                    {
+                        renderer.threads = t;
+                        started = std::chrono::steady_clock::now();
+                        delete[] renderer.capture(int(r), int(r), 0, d);
+                        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+                        const RenderStats& s = renderer.stats;
+                        const double paths = double(r) * r;
+                        Row row = { p, l, d, r, t, buildMs, ms, paths / (ms * 1e3), (paths + s.reflectionRays + s.shadowRays) / (ms * 1e3), -1, peakRss() };
+                        if (t == 1) single = ms;
+                        if (single > 0) row.efficiency = single / ms / (t ? t : std::max(1u, std::thread::hardware_concurrency()));
+                        if (json)
+                            printf("%s  {\"prims\": %zu, \"lights\": %zu, \"depth\": %zu, \"width\": %zu, \"height\": %zu, \"threads\": %zu, "
+                                "\"build_ms\": %.2f, \"render_ms\": %.2f, \"mpaths_per_s\": %.3f, \"mrays_per_s\": %.3f, "
+                                "\"efficiency\": %s, \"peak_rss_mb\": %.1f}",
+                                printed ? ",\n" : "", p, l, d, r, r, t, buildMs, ms, row.mpaths, row.mrays,
+                                row.efficiency < 0 ? "null" : std::to_string(row.efficiency).c_str(), row.rssMb);
+                        else
+                        {
+                            printf("%zu,%zu,%zu,%zu,%zu,%zu,%.2f,%.2f,%.3f,%.3f,", p, l, d, r, r, t, buildMs, ms, row.mpaths, row.mrays);
+                            if (row.efficiency >= 0) printf("%.3f", row.efficiency);
+                            printf(",%.1f\n", row.rssMb);
+                        }
+                        fflush(stdout);
+                        ++printed;
+                    }
+                }
+        }
+    }
+    if (json)
+        printf("\n]}\n");
+    return 0;
+}
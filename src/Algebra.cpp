@@ -1,122 +1,55 @@
-#include <math.h>                           /* sqrt */
 #include "Algebra.h"               /* self definition */
+#include <float.h>                          /* DBL_MAX */
 
-
-Vec3d::Vec3d(double _x, double _y, double _z):
-    x(_x), y(_y), z(_z)
-{
-}
-
-Vec3d::Vec3d(const Vec3d & from, const Vec3d & to)
-{
-    x = to.x - from.x;
-    y = to.y - from.y;
-    z = to.z - from.z;
-}
-
-Vec3d Vec3d::operator-(const Vec3d & b) const
-{
-    return Vec3d(x - b.x, y - b.y, z - b.z);
-}
-
-Vec3d Vec3d::operator+(const Vec3d & b) const
+BBox::BBox() :
+    min(DBL_MAX, DBL_MAX, DBL_MAX), max(-DBL_MAX, -DBL_MAX, -DBL_MAX)
 {
-    return Vec3d(x + b.x, y + b.y, z + b.z);
 }
 
-Vec3d Vec3d::operator*(const double b) const
+BBox::BBox(const Vec3d & _min, const Vec3d & _max) :
+    min(_min), max(_max)
 {
-    return Vec3d(x * b, y * b, z * b);
 }
 
-Vec3d Vec3d::operator*(const Vec3d & b) const
+BBox & BBox::extend(const Vec3d & v)
 {
-    return Vec3d(y * b.z - z * b.y, z * b.x - x * b.z,
-        x * b.y - y * b.x);
-}
-
-Vec3d& Vec3d::operator-=(const Vec3d & b)
-{
-    x -= b.x; y -= b.y; z -= b.z;
-    return *this;
-}
-
-Vec3d& Vec3d::operator+=(const Vec3d & b)
-{
-    x += b.x; y += b.y; z += b.z;
+    if (v.x < min.x) min.x = v.x;
+    if (v.y < min.y) min.y = v.y;
+    if (v.z < min.z) min.z = v.z;
+    if (v.x > max.x) max.x = v.x;
+    if (v.y > max.y) max.y = v.y;
+    if (v.z > max.z) max.z = v.z;
     return *this;
 }
 
-Vec3d& Vec3d::operator*=(const double b)
+BBox & BBox::extend(const BBox & b)
 {
-    x *= b, y *= b, z *= b;
+    if (b.min.x < min.x) min.x = b.min.x;           /* an empty b changes nothing */
+    if (b.min.y < min.y) min.y = b.min.y;
+    if (b.min.z < min.z) min.z = b.min.z;
+    if (b.max.x > max.x) max.x = b.max.x;
+    if (b.max.y > max.y) max.y = b.max.y;
+    if (b.max.z > max.z) max.z = b.max.z;
     return *this;
 }
 
-Vec3d& Vec3d::operator*=(const Vec3d & b) 
+Vec3d BBox::centre() const
 {
-    x = y * b.z - z * b.y;
-    y = z * b.x - x * b.z;
-    z = x * b.y - y * b.x;
-    return *this;
+    return (min + max) * 0.5;
 }
 
-Vec3d Vec3d::blend(const Vec3d & b) const
-{
-    return Vec3d(x * b.x, y * b.y, z * b.z);
-}
-
-Vec3d & Vec3d::zero()
-{
-   x = y = z = 0; 
-   return *this;
-}
-
-Vec3d & Vec3d::set(const Vec3d & to)
-{
-    x = to.x; 
-    y = to.y;
-    z = to.z;
-    return *this;
-}
-
-Vec3d & Vec3d::set(const double _x, const double _y, const double _z)
-{
-    x = _x;
-    y = _y;
-    z = _z;
-    return *this;
-}
-
-double Vec3d::length() const
-{
-    return (sqrt(x * x + y * y + z * z));
-}
-
-Vec3d Vec3d::unit() const
-{
-    const double l = length();
-    return Vec3d(x / l, y / l, z / l);
-}
-
-double Vec3d::dot(const Vec3d & b) const
-{
-   return(x * b.x + y * b.y + z * b.z);
-}
-
-Plane::Plane(const Vec3d & normal, const Vec3d & origine) :
-    a(normal.x), b(normal.y), c(normal.z), d(-(origine.x * normal.x + origine.y * normal.y + origine.z * normal.z))
+/////////////////////////////////////////////////////////////
+  ///Area of the box's surface, 0 for an empty box.
+/////////////////////////////////////////////////////////////
+double BBox::surface() const
 {
+    const Vec3d d(min, max);
+    if (d.x < 0 || d.y < 0 || d.z < 0) return 0.0;
+    return 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
 }
 
-/////////////////////////////////////////////////////////////
-  ///Checking if a vertex belongs to the plane.             
-  ///                                                       
-  /// RETURNS: 0   when the vertex belongs to the plane     
-  ///          + when in the normal pointed halfplane                                
-  ///          - otherwise.                                
-/////////////////////////////////////////////////////////////
-double Plane::vertexOnPlane(const Vec3d & vertex) const
+int BBox::longestAxis() const
 {
-    return vertex.x * a + vertex.y * b + vertex.z * c + d;
+    const Vec3d d(min, max);
+    return (d.x >= d.y && d.x >= d.z) ? 0 : (d.y >= d.z ? 1 : 2);
 }
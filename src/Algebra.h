@@ -1,39 +1,134 @@
 #ifndef _VECTOR_H_
 #define _VECTOR_H_
 
-class Vec3d
+#include <math.h>               /* sqrt */
+#include "Simd.h"
+#if defined(RTR_FAST_UNIT) && defined(SIMD_X86)
+#include <xmmintrin.h>          /* rsqrtss */
+#endif
+
+#ifdef RTR_SINGLE_PRECISION
+typedef float Real;             /* scalar of the tracer, float builds trade range for speed */
+#else
+typedef double Real;
+#endif
+
+#if defined(_MSC_VER)
+#define FORCE_INLINE __forceinline
+#elif defined(__GNUC__)
+#define FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define FORCE_INLINE inline
+#endif
+
+////////////////////////////////////////////////////////////
+/// 1 / sqrt(v). With RTR_FAST_UNIT on x86 it is the 12 bit
+/// estimate of rsqrtss refined by one Newton step, about 22
+/// bits: close to float precision and faster than a divide
+/// and a square root, but no longer exact.
+////////////////////////////////////////////////////////////
+template <class T>
+FORCE_INLINE T rsqrt(const T v)
+{
+#if defined(RTR_FAST_UNIT) && defined(SIMD_X86)
+    const T r = T(_mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(float(v)))));
+    return r * (T(1.5) - T(0.5) * v * r * r);
+#else
+    return T(1) / sqrt(v);
+#endif
+}
+
+////////////////////////////////////////////////////////////
+/// Vector of three T. Everything is defined here so the
+/// compiler sees through it in the inner loops of every
+/// unit; the pure operations are constexpr.
+////////////////////////////////////////////////////////////
+template <class T>
+class Vec3
 {
 public:
-    double x, y, z;
-    Vec3d() = default;
-    Vec3d(double _x, double _y, double _z);
-    Vec3d(const Vec3d& from, const Vec3d& to);
-    Vec3d operator - (const Vec3d& b) const;
-    Vec3d operator + (const Vec3d& b) const;
-    Vec3d operator * (const double b) const;
-    Vec3d operator * (const Vec3d& b) const; //Cross Product
-
-    Vec3d& operator -= (const Vec3d& b);
-    Vec3d& operator += (const Vec3d& b);
-    Vec3d& operator *= (const double b);
-    Vec3d& operator *= (const Vec3d& b); //Cross Product
-
-    Vec3d blend(const Vec3d& b) const;
-    Vec3d& zero();
-    Vec3d& set(const Vec3d& to);
-    Vec3d& set(const double _x, const double _y, const double _z);
-    double length() const;
-    Vec3d unit() const;
-    double dot(const Vec3d& b) const;
+    T x, y, z;
+    Vec3() = default;
+    constexpr Vec3(T _x, T _y, T _z) : x(_x), y(_y), z(_z) {}
+    constexpr Vec3(const Vec3& from, const Vec3& to) : x(to.x - from.x), y(to.y - from.y), z(to.z - from.z) {}
+    template <class U> constexpr explicit Vec3(const Vec3<U>& v) : x(T(v.x)), y(T(v.y)), z(T(v.z)) {}
+
+    FORCE_INLINE constexpr Vec3 operator - (const Vec3& b) const { return Vec3(x - b.x, y - b.y, z - b.z); }
+    FORCE_INLINE constexpr Vec3 operator + (const Vec3& b) const { return Vec3(x + b.x, y + b.y, z + b.z); }
+    FORCE_INLINE constexpr Vec3 operator * (const T b) const { return Vec3(x * b, y * b, z * b); }
+    FORCE_INLINE constexpr Vec3 operator * (const Vec3& b) const //Cross Product
+    {
+        return Vec3(y * b.z - z * b.y, z * b.x - x * b.z, x * b.y - y * b.x);
+    }
+
+    FORCE_INLINE Vec3& operator -= (const Vec3& b) { x -= b.x; y -= b.y; z -= b.z; return *this; }
+    FORCE_INLINE Vec3& operator += (const Vec3& b) { x += b.x; y += b.y; z += b.z; return *this; }
+    FORCE_INLINE Vec3& operator *= (const T b) { x *= b; y *= b; z *= b; return *this; }
+    FORCE_INLINE Vec3& operator *= (const Vec3& b) //Cross Product
+    {
+        x = y * b.z - z * b.y;
+        y = z * b.x - x * b.z;
+        z = x * b.y - y * b.x;
+        return *this;
+    }
+
+    FORCE_INLINE constexpr Vec3 blend(const Vec3& b) const { return Vec3(x * b.x, y * b.y, z * b.z); }
+    FORCE_INLINE Vec3& zero() { x = y = z = 0; return *this; }
+    FORCE_INLINE Vec3& set(const Vec3& to) { x = to.x; y = to.y; z = to.z; return *this; }
+    FORCE_INLINE Vec3& set(const T _x, const T _y, const T _z) { x = _x; y = _y; z = _z; return *this; }
+    FORCE_INLINE T length() const { return sqrt(x * x + y * y + z * z); }
+    FORCE_INLINE Vec3 unit() const
+    {
+#ifdef RTR_FAST_UNIT
+        const T r = rsqrt(dot(*this));
+        return Vec3(x * r, y * r, z * r);
+#else
+        const T l = length();
+        return Vec3(x / l, y / l, z / l);
+#endif
+    }
+    FORCE_INLINE constexpr T dot(const Vec3& b) const { return x * b.x + y * b.y + z * b.z; }
+    FORCE_INLINE constexpr T operator [] (const int axis) const { return axis == 0 ? x : (axis == 1 ? y : z); }
 };
 
+typedef Vec3<double> Vec3d;
+typedef Vec3<float> Vec3f;
+typedef Vec3<Real> Vec3r;       // vectors of the tracer
+
+template <class T>
 class Plane
 {
 private:
-    double a, b, c, d;
+    T a, b, c, d;
+public:
+    constexpr Plane(const Vec3<T>& normal, const Vec3<T>& origine) :
+        a(normal.x), b(normal.y), c(normal.z), d(-(origine.x * normal.x + origine.y * normal.y + origine.z * normal.z))
+    {
+    }
+    ////////////////////////////////////////////////////////
+    ///Checking if a vertex belongs to the plane.
+    ///
+    /// RETURNS: 0   when the vertex belongs to the plane
+    ///          + when in the normal pointed halfplane
+    ///          - otherwise.
+    ////////////////////////////////////////////////////////
+    FORCE_INLINE constexpr T vertexOnPlane(const Vec3<T>& vertex) const
+    {
+        return vertex.x * a + vertex.y * b + vertex.z * c + d;
+    }
+};
+
+class BBox
+{
 public:
-    Plane(const Vec3d& normal, const Vec3d& origine);
-    double vertexOnPlane(const Vec3d& vertex) const;
+    Vec3d min, max;             // opposite corners, min > max when empty
+    BBox();
+    BBox(const Vec3d& _min, const Vec3d& _max);
+    BBox& extend(const Vec3d& v);
+    BBox& extend(const BBox& b);
+    Vec3d centre() const;
+    double surface() const;
+    int longestAxis() const;
 };
 
 #endif
@@ -0,0 +1,724 @@
+#include "BVH.h"                /* self definition */
+#include "Trace.h"              /* BaseObject */
+#include "ThreadPool.h"
+#include "SceneCache.h"
+#include "Timeline.h"
+#include <math.h>               /* nextafterf */
+#include <float.h>              /* DBL_MAX, FLT_MAX */
+#include <chrono>               /* steady_clock */
+#include <algorithm>            /* nth_element, partition, stable_partition */
+
+#define BVH_LEAF_SIZE 4         /* objects below which the median split makes a leaf */
+#define BVH_MAX_LEAF 8          /* objects above which the SAH split never makes a leaf */
+#define BVH_BINS 16             /* candidate split planes per axis are the bin borders */
+#define BVH_TRAVERSAL_COST 0.125 /* visiting a node, relative to testing an object */
+#define BVH_PARALLEL_BUILD 4096 /* ranges this large are worth a task of their own */
+#define BVH_SAH_DEPTH 32        /* deeper ranges split at the median to keep within BVH_STACK */
+#define BVH_STACK 64            /* nodes a traversal can have pending */
+
+static_assert(sizeof(BVH::Node) == 32, "two BVH nodes per cache line");
+
+////////////////////////////////////////////////////////////
+/// Slab test of a ray against a node, clipped to [tmin, tmax].
+/// Slabs giving NaN (ray parallel and starting on a face)
+/// are ignored, which errs on the side of visiting a node.
+////////////////////////////////////////////////////////////
+static inline bool slabs(const BVH::Node& n, const Ray& r, Real tmax)
+{
+    Real tmin = r.tmin;
+    for (int a = 0; a < 3; ++a)
+    {
+        Real t0 = (n.min[a] - r.start[a]) * r.inverse[a],
+            t1 = (n.max[a] - r.start[a]) * r.inverse[a];
+        if (t0 > t1) std::swap(t0, t1);
+        if (t0 > tmin) tmin = t0;
+        if (t1 < tmax) tmax = t1;
+        if (tmin > tmax) return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Rounding a bound to float away from the box, so the
+/// stored node still encloses everything below it.
+////////////////////////////////////////////////////////////
+static float lower(const double v)
+{
+    const float f = float(v);
+    return f > v ? nextafterf(f, -FLT_MAX) : f;
+}
+
+static float upper(const double v)
+{
+    const float f = float(v);
+    return f < v ? nextafterf(f, FLT_MAX) : f;
+}
+
+TraversalStats::TraversalStats() :
+    nodes(0)
+{
+    for (unsigned long long& t : tests)
+        t = 0;
+}
+
+TraversalStats& TraversalStats::operator += (const TraversalStats& s)
+{
+    nodes += s.nodes;
+    for (int i = 0; i <= PrimObject; ++i)
+        tests[i] += s.tests[i];
+    return *this;
+}
+
+BVH::BVH() :
+    boxes(boxPacketScalar), mode(SAH)
+{
+    info.buildMs = info.sahCost = 0.0;
+    info.nodes = info.leaves = info.depth = 0;
+}
+
+////////////////////////////////////////////////////////////
+/// Builds the hierarchy over the current objects, taking
+/// each triangle of a mesh as a prim of its own. Has to
+/// run again whenever objects are added, moved or removed.
+/// With a pool, ranges large enough are binned in parallel
+/// and the subtrees below them are built one per task.
+////////////////////////////////////////////////////////////
+void BVH::build(const std::vector<BaseObject*>& objects, const Mode _mode, ThreadPool* pool, const SimdLevel simd)
+{
+    const TimelineSpan span("bvh build");
+    const auto started = std::chrono::steady_clock::now();
+    size_t size = 0;
+    mode = _mode;
+    for (const BaseObject* o : objects)
+        size += o->parts();
+    refs.resize(size);
+    size_t i = 0;
+    for (BaseObject* o : objects)
+    {
+        const unsigned char type = (unsigned char)PrimitiveStore::typeOf(o);
+        for (size_t part = 0, parts = o->parts(); part < parts; ++part, ++i)
+        {
+            refs[i].object = o;
+            refs[i].part = (unsigned int)part;
+            refs[i].type = type;
+            refs[i].box = o->partBounds(part);
+            refs[i].centre = refs[i].box.centre();
+        }
+    }
+
+    nodes.clear();
+    if (size)
+    {
+        Build root;
+        if (pool && pool->size() > 1 && size >= BVH_PARALLEL_BUILD)
+        {
+            std::vector<Task> deferred;
+            split(root, 0, size, 1, pool, &deferred);
+            pool->run(deferred.size(), [&](const size_t task, const size_t)
+            {
+                const Task& t = deferred[task];
+                split(*t.node, t.first, t.last, t.depth, nullptr, nullptr);
+            });
+        }
+        else
+            split(root, 0, size, 1, nullptr, nullptr);
+        nodes.reserve(2 * size);
+        flatten(root);
+    }
+
+    gather();
+    std::vector<Ref>().swap(refs);
+    select(simd);
+
+    info.nodes = info.leaves = info.depth = 0;
+    info.sahCost = 0.0;
+    if (size)
+    {
+        const Node& n = nodes[0];
+        measure(0, 1, BBox(Vec3d(n.min[0], n.min[1], n.min[2]), Vec3d(n.max[0], n.max[1], n.max[2])).surface());
+    }
+    info.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+////////////////////////////////////////////////////////////
+/// Computes the bounds of refs[first, last) and of their
+/// centres, in chunks on the pool when one is given.
+////////////////////////////////////////////////////////////
+void BVH::enclose(BBox& box, BBox& centres, const size_t first, const size_t last, ThreadPool* pool) const
+{
+    if (!pool)
+    {
+        for (size_t i = first; i < last; ++i)
+        {
+            box.extend(refs[i].box);
+            centres.extend(refs[i].centre);
+        }
+        return;
+    }
+    const size_t chunks = pool->size() * 4;
+    std::vector<BBox> boxes(chunks), centre(chunks);
+    pool->run(chunks, [&](const size_t c, const size_t)
+    {
+        for (size_t i = first + (last - first) * c / chunks; i < first + (last - first) * (c + 1) / chunks; ++i)
+        {
+            boxes[c].extend(refs[i].box);
+            centre[c].extend(refs[i].centre);
+        }
+    });
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        box.extend(boxes[c]);
+        centres.extend(centre[c]);
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Turns n into the subtree over refs[first, last). Ranges
+/// below the parallel threshold are put on deferred, when
+/// given, for the pool to build afterwards.
+////////////////////////////////////////////////////////////
+void BVH::split(Build& n, const size_t first, const size_t last, const size_t depth, ThreadPool* pool, std::vector<Task>* deferred)
+{
+    const bool wide = pool && last - first >= BVH_PARALLEL_BUILD;
+    BBox centres;
+    enclose(n.box, centres, first, last, wide ? pool : nullptr);
+    n.first = first;
+    n.count = last - first;
+    n.axis = 0;
+
+    const size_t mid = (mode == SAH && depth < BVH_SAH_DEPTH) ?
+        binned(n, centres, first, last, n.axis, wide ? pool : nullptr) : median(centres, first, last, n.axis);
+    if (mid == first || mid == last)            /* cheaper as a leaf */
+        return;
+
+    n.left.reset(new Build);
+    n.right.reset(new Build);
+    n.count = 0;
+    if (deferred && mid - first < BVH_PARALLEL_BUILD)
+        deferred->push_back(Task{ n.left.get(), first, mid, depth + 1 });
+    else
+        split(*n.left, first, mid, depth + 1, pool, deferred);
+    if (deferred && last - mid < BVH_PARALLEL_BUILD)
+        deferred->push_back(Task{ n.right.get(), mid, last, depth + 1 });
+    else
+        split(*n.right, mid, last, depth + 1, pool, deferred);
+}
+
+////////////////////////////////////////////////////////////
+/// Splitting refs[first, last) at the median of the centres
+/// along the longest axis of their bounds.
+///
+/// RETURNS: First ref of the right half, first for a leaf.
+////////////////////////////////////////////////////////////
+size_t BVH::median(const BBox& centres, const size_t first, const size_t last, int& axis)
+{
+    if (last - first <= BVH_LEAF_SIZE)
+        return first;
+    axis = centres.longestAxis();
+    const size_t mid = (first + last) / 2;
+    std::nth_element(refs.begin() + first, refs.begin() + mid, refs.begin() + last,
+        [axis](const Ref& a, const Ref& b) { return a.centre[axis] < b.centre[axis]; });
+    return mid;
+}
+
+////////////////////////////////////////////////////////////
+/// Splitting refs[first, last) where the surface area
+/// heuristic is lowest, sampled at the borders of
+/// BVH_BINS equal bins along each axis.
+///
+/// RETURNS: First ref of the right half, first for a leaf.
+////////////////////////////////////////////////////////////
+size_t BVH::binned(const Build& n, const BBox& centres, const size_t first, const size_t last, int& axis, ThreadPool* pool)
+{
+    struct Bin
+    {
+        BBox box;
+        size_t count;
+    };
+    const size_t count = last - first;
+    const size_t chunks = pool ? pool->size() * 4 : 1;
+    Bin local[3 * BVH_BINS];                        /* serial builds stay off the heap */
+    std::vector<Bin> shared(pool ? chunks * 3 * BVH_BINS : 0);
+    Bin* bins = pool ? shared.data() : local;
+    for (size_t i = 0; i < chunks * 3 * BVH_BINS; ++i)
+        bins[i].count = 0;
+    double scale[3];
+    for (int a = 0; a < 3; ++a)
+        scale[a] = centres.max[a] > centres.min[a] ? BVH_BINS / (centres.max[a] - centres.min[a]) : 0.0;
+    auto slot = [&centres, &scale](const Vec3d& c, const int a)
+    {
+        const int b = int((c[a] - centres.min[a]) * scale[a]);
+        return b < 0 ? 0 : (b >= BVH_BINS ? BVH_BINS - 1 : b);
+    };
+    auto job = [&](const size_t c, const size_t)
+    {
+        Bin* own = &bins[c * 3 * BVH_BINS];
+        for (size_t i = first + count * c / chunks; i < first + count * (c + 1) / chunks; ++i)
+            for (int a = 0; a < 3; ++a)
+                if (scale[a] > 0.0)
+                {
+                    Bin& b = own[a * BVH_BINS + slot(refs[i].centre, a)];
+                    b.box.extend(refs[i].box);
+                    ++b.count;
+                }
+    };
+    if (pool) pool->run(chunks, job);
+    else job(0, 0);
+    for (size_t c = 1; c < chunks; ++c)
+        for (int i = 0; i < 3 * BVH_BINS; ++i)
+        {
+            bins[i].box.extend(bins[c * 3 * BVH_BINS + i].box);
+            bins[i].count += bins[c * 3 * BVH_BINS + i].count;
+        }
+
+    double best = DBL_MAX;
+    int bestAxis = -1, bestBin = 0;
+    for (int a = 0; a < 3; ++a)
+    {
+        if (!(scale[a] > 0.0)) continue;
+        const Bin* axis = &bins[a * BVH_BINS];
+        double rightCost[BVH_BINS];
+        BBox box;
+        size_t right = 0;
+        for (int i = BVH_BINS - 1; i > 0; --i)      /* cost of the right side of each border */
+        {
+            if (axis[i].count) box.extend(axis[i].box);
+            right += axis[i].count;
+            rightCost[i] = box.surface() * right;
+        }
+        box = BBox();
+        size_t left = 0;
+        for (int i = 0; i < BVH_BINS - 1; ++i)
+        {
+            if (axis[i].count) box.extend(axis[i].box);
+            left += axis[i].count;
+            const double cost = box.surface() * left + rightCost[i + 1];
+            if (left && left < count && cost < best)
+            {
+                best = cost;
+                bestAxis = a;
+                bestBin = i;
+            }
+        }
+    }
+
+    const double area = n.box.surface();
+    best = area > 0.0 ? BVH_TRAVERSAL_COST + best / area : BVH_TRAVERSAL_COST + count;
+    if (bestAxis < 0)                               /* all centres at the same point */
+    {
+        axis = 0;
+        return count <= BVH_MAX_LEAF ? first : (first + last) / 2;
+    }
+    if (count <= BVH_MAX_LEAF && count <= best)
+        return first;
+
+    axis = bestAxis;
+    return std::partition(refs.begin() + first, refs.begin() + last,
+        [&](const Ref& r) { return slot(r.centre, bestAxis) <= bestBin; }) - refs.begin();
+}
+
+////////////////////////////////////////////////////////////
+/// Appending a built subtree to nodes in depth first order.
+///
+/// RETURNS: Index of the subtree's root.
+////////////////////////////////////////////////////////////
+unsigned int BVH::flatten(const Build& b)
+{
+    const unsigned int index = (unsigned int)nodes.size();
+    nodes.push_back(Node());
+    Node& n = nodes.back();
+    n.min[0] = lower(b.box.min.x); n.min[1] = lower(b.box.min.y); n.min[2] = lower(b.box.min.z);
+    n.max[0] = upper(b.box.max.x); n.max[1] = upper(b.box.max.y); n.max[2] = upper(b.box.max.z);
+    n.count = (unsigned short)b.count;
+    n.axis = (unsigned char)b.axis;
+    n.spheres = 0;
+    if (b.count)
+    {
+        n.offset = (unsigned int)b.first;
+        return index;
+    }
+    flatten(*b.left);                               /* lands right after index */
+    const unsigned int second = flatten(*b.right);
+    nodes[index].offset = second;                   /* n may have moved */
+    return index;
+}
+
+////////////////////////////////////////////////////////////
+/// Picking the sphere kernels, clamped to what the CPU has,
+/// and the box kernels of the same width.
+////////////////////////////////////////////////////////////
+void BVH::select(const SimdLevel simd)
+{
+    prims.spheres.select(simd);
+    switch (prims.spheres.level())
+    {
+#ifdef SIMD_AVX512
+    case SimdAVX512: boxes = boxPacketAVX512; break;
+#endif
+#ifdef SIMD_X86
+    case SimdAVX2: boxes = boxPacketAVX2; break;
+    case SimdSSE2: boxes = boxPacketSSE2; break;
+#endif
+    default: boxes = boxPacketScalar; break;
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Writing the nodes, their figures and the prims to a
+/// scene cache.
+///
+/// RETURNS: false when the prims cannot be cached.
+////////////////////////////////////////////////////////////
+bool BVH::save(CacheWriter& out) const
+{
+    out.put(nodes);
+    out.value(info);
+    return prims.save(out);
+}
+
+////////////////////////////////////////////////////////////
+/// Viewing the nodes and prims of a scene cache in place of
+/// a build. Nothing is traced until validate has passed.
+///
+/// RETURNS: false when the cache is cut short or malformed.
+////////////////////////////////////////////////////////////
+bool BVH::attach(CacheReader& in)
+{
+    return in.get(nodes) && in.value(info) && prims.attach(in);
+}
+
+////////////////////////////////////////////////////////////
+/// Checking an attached hierarchy the way build would have
+/// made it: every node the child of exactly one parent,
+/// laid out depth first, so the subtree of a node is the
+/// range of nodes from it up to where its parent's ends;
+/// split axes valid, leaves within the prims with their
+/// spheres first, no deeper than a traversal can follow;
+/// then selecting the kernels as build does.
+///
+/// RETURNS: true when it is safe to trace.
+////////////////////////////////////////////////////////////
+bool BVH::validate(const SimdLevel simd)
+{
+    const size_t size = nodes.size(), count = prims.size();
+    if (!prims.validate() || (!size && count))
+        return false;
+    std::vector<unsigned int> depth(size, 0), end(size, 0);    /* end 0 - not reached from a parent yet */
+    if (size) end[0] = (unsigned int)size;
+    for (size_t i = 0; i < size; ++i)
+    {
+        const Node& n = nodes[i];
+        if (!end[i] || depth[i] >= BVH_STACK)
+            return false;
+        if (n.count)
+        {
+            if (end[i] != i + 1 || (size_t)n.offset + n.count > count || n.spheres > n.count)
+                return false;
+            for (unsigned int p = n.offset; p < n.offset + n.count; ++p)
+                if ((prims.type(p) == PrimSphere) != (p < n.offset + n.spheres))
+                    return false;
+        }
+        else
+        {
+            if (n.offset <= i + 1 || n.offset >= end[i] || end[i + 1] || end[n.offset] || n.axis > 2)
+                return false;
+            end[i + 1] = n.offset;                  /* first subtree up to the second */
+            end[n.offset] = end[i];
+            depth[i + 1] = depth[n.offset] = depth[i] + 1;
+        }
+    }
+    select(simd);
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Ordering the prims of each leaf by type, spheres first,
+/// and filling the store in that order, so a leaf tests
+/// its spheres with one kernel call and the rest in runs
+/// of one type.
+////////////////////////////////////////////////////////////
+void BVH::gather()
+{
+    std::vector<PrimRef> order(refs.size());
+    for (Node& n : nodes)
+        if (n.count)
+        {
+            const auto first = refs.begin() + n.offset, last = first + n.count;
+            std::stable_sort(first, last, [](const Ref& a, const Ref& b) { return a.type < b.type; });
+            n.spheres = (unsigned char)(std::partition_point(first, last,
+                [](const Ref& r) { return r.type == PrimSphere; }) - first);
+        }
+    for (size_t i = 0; i < refs.size(); ++i)
+    {
+        order[i].object = refs[i].object;
+        order[i].part = refs[i].part;
+        order[i].type = PrimType(refs[i].type);
+    }
+    prims.assign(order);
+}
+
+////////////////////////////////////////////////////////////
+/// Gathering node count, depth and SAH cost of a subtree.
+////////////////////////////////////////////////////////////
+void BVH::measure(const unsigned int index, const size_t depth, const double area)
+{
+    const Node& n = nodes[index];
+    const double surface = BBox(Vec3d(n.min[0], n.min[1], n.min[2]), Vec3d(n.max[0], n.max[1], n.max[2])).surface();
+    const double p = area > 0.0 ? surface / area : 1.0;    /* chance a ray visits n */
+    ++info.nodes;
+    if (n.count)
+    {
+        ++info.leaves;
+        info.sahCost += p * n.count;
+        if (depth > info.depth) info.depth = depth;
+        return;
+    }
+    info.sahCost += p * BVH_TRAVERSAL_COST;
+    measure(index + 1, depth + 1, area);
+    measure(n.offset, depth + 1, area);
+}
+
+////////////////////////////////////////////////////////////
+/// Finding the closest prim hit by the ray within its
+/// interval. Children are visited nearest first along the
+/// split axis; tmax shrinks to each hit found, which prunes
+/// the far nodes and lets prims reject farther hits early.
+/// Only the prim finished with gets its record completed.
+///
+/// RETURNS: true and the filled record when a prim is hit;
+///          false otherwise.
+////////////////////////////////////////////////////////////
+bool BVH::closestHit(const Ray& r, const unsigned int skip, HitRecord& record, TraversalStats& stats) const
+{
+    record.prim = PrimitiveStore::none;
+    if (nodes.empty()) return false;
+    Ray ray(r);
+    const SphereQuery q(r);
+    const size_t skipSphere = prims.sphere(skip);
+    unsigned int hit = PrimitiveStore::none;
+    unsigned int stack[BVH_STACK], top = 0, i = 0;
+    RTR_STAT(unsigned long long visited = 0);       /* kept in a register, added once */
+    (void)stats;                                    /* not counted into with RTR_NO_STATS */
+    for (;;)
+    {
+        const Node& n = nodes[i];
+        RTR_STAT(++visited);
+        if (slabs(n, ray, ray.tmax))
+        {
+            if (!n.count)
+            {
+                if (ray.negative[n.axis])
+                {
+                    stack[top++] = i + 1;
+                    i = n.offset;
+                }
+                else
+                {
+                    stack[top++] = n.offset;
+                    ++i;
+                }
+                continue;
+            }
+            if (n.spheres)
+            {
+                RTR_STAT(stats.tests[PrimSphere] += n.spheres);
+                const size_t first = prims.sphere(n.offset),
+                    s = prims.spheres.closest(q, skipSphere, first, n.spheres, ray.tmax);
+                if (s != SphereSoA::none) hit = n.offset + (unsigned int)(s - first);
+            }
+            for (unsigned int p = n.offset + n.spheres; p < n.offset + n.count; ++p)
+                if (p != skip)
+                {
+                    RTR_STAT(++stats.tests[prims.type(p)]);
+                    const Real d = prims.intersect(p, ray);
+                    if (ray.within(d))
+                    {
+                        ray.tmax = d;
+                        hit = p;
+                    }
+                }
+        }
+        if (!top) break;
+        i = stack[--top];
+    }
+    RTR_STAT(stats.nodes += visited);
+    if (hit == PrimitiveStore::none) return false;
+    record.t = ray.tmax;
+    record.prim = hit;
+    prims.complete(r, record);
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Looking for any prim hit by the ray within (tmin, tmax],
+/// stopping at the first one found.
+///
+/// RETURNS: Its slot, PrimitiveStore::none if there is none.
+////////////////////////////////////////////////////////////
+unsigned int BVH::anyHit(const Ray& r, const unsigned int skip, TraversalStats& stats) const
+{
+    if (nodes.empty()) return PrimitiveStore::none;
+    const Real tmax = r.tmax;
+    const SphereQuery q(r);
+    const size_t skipSphere = prims.sphere(skip);
+    unsigned int stack[BVH_STACK], top = 0, i = 0;
+    RTR_STAT(unsigned long long visited = 0);       /* kept in a register, added once */
+    (void)stats;                                    /* not counted into with RTR_NO_STATS */
+    for (;;)
+    {
+        const Node& n = nodes[i];
+        RTR_STAT(++visited);
+        if (slabs(n, r, tmax))
+        {
+            if (!n.count)
+            {
+                stack[top++] = n.offset;
+                ++i;
+                continue;
+            }
+            if (n.spheres)
+            {
+                RTR_STAT(stats.tests[PrimSphere] += n.spheres);
+                const size_t first = prims.sphere(n.offset),
+                    s = prims.spheres.any(q, skipSphere, first, n.spheres, tmax);
+                if (s != SphereSoA::none)
+                {
+                    RTR_STAT(stats.nodes += visited);
+                    return n.offset + (unsigned int)(s - first);
+                }
+            }
+            for (unsigned int p = n.offset + n.spheres; p < n.offset + n.count; ++p)
+                if (p != skip)
+                {
+                    RTR_STAT(++stats.tests[prims.type(p)]);
+                    const Real d = prims.intersect(p, r);
+                    if ((d > r.tmin) && (d <= tmax))
+                    {
+                        RTR_STAT(stats.nodes += visited);
+                        return p;
+                    }
+                }
+        }
+        if (!top)
+        {
+            RTR_STAT(stats.nodes += visited);
+            return PrimitiveStore::none;
+        }
+        i = stack[--top];
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Finding the closest hit of every lane of a packet within
+/// (0, p.t). A node is entered while any lane meets its box
+/// and the lanes missing it are masked out below; children
+/// are ordered by the direction of the first lane.
+////////////////////////////////////////////////////////////
+void BVH::closestHit(RayPacket& p, TraversalStats& stats) const
+{
+    const size_t size = p.size, lanes = (size + SPHERE_LANES - 1) / SPHERE_LANES * SPHERE_LANES;
+    for (size_t l = 0; l < size; ++l)
+        p.hit[l] = PrimitiveStore::none;
+    if (nodes.empty() || !size) return;
+
+    alignas(64) Real ix[PACKET_LANES], iy[PACKET_LANES], iz[PACKET_LANES];
+    alignas(64) Real limit[PACKET_LANES], d[PACKET_LANES];
+    size_t sphere[PACKET_LANES];
+    for (size_t l = 0; l < lanes; ++l)
+    {
+        if (l >= size)                                  /* padding lanes never hit */
+        {
+            p.dx[l] = p.dy[l] = p.dz[l] = 0.0;
+            p.t[l] = 0.0;
+        }
+        ix[l] = 1 / p.dx[l];
+        iy[l] = 1 / p.dy[l];
+        iz[l] = 1 / p.dz[l];
+    }
+    const SpherePacket sp = { lanes, p.start.x, p.start.y, p.start.z, p.dx, p.dy, p.dz, limit, sphere };
+    const BoxPacket bp = { lanes, ix, iy, iz, p.t };
+    const unsigned long long used = size == 64 ? ~0ull : (1ull << size) - 1;
+    (void)stats;                                    /* not counted into with RTR_NO_STATS */
+    const bool negative[3] = { p.dx[0] < 0, p.dy[0] < 0, p.dz[0] < 0 };
+
+    unsigned int stack[BVH_STACK], top = 0, i = 0;
+    for (;;)
+    {
+        const Node& n = nodes[i];
+        const Real lo[3] = { n.min[0] - p.start.x, n.min[1] - p.start.y, n.min[2] - p.start.z },
+            hi[3] = { n.max[0] - p.start.x, n.max[1] - p.start.y, n.max[2] - p.start.z };
+        const unsigned long long active = boxes(bp, lo, hi) & used;
+        RTR_STAT(++stats.nodes);
+        if (active)
+        {
+            if (!n.count)
+            {
+                if (negative[n.axis])
+                {
+                    stack[top++] = i + 1;
+                    i = n.offset;
+                }
+                else
+                {
+                    stack[top++] = n.offset;
+                    ++i;
+                }
+                continue;
+            }
+            if (n.spheres)
+            {
+                for (size_t l = 0; l < lanes; ++l)
+                {
+                    limit[l] = ((active >> l) & 1) ? p.t[l] : 0.0;
+                    sphere[l] = SphereSoA::none;
+                }
+                RTR_STAT(stats.tests[PrimSphere] += size * n.spheres);
+                const size_t first = prims.sphere(n.offset);
+                prims.spheres.packet(sp, first, n.spheres);
+                for (size_t l = 0; l < size; ++l)
+                    if (sphere[l] != SphereSoA::none)
+                    {
+                        p.t[l] = limit[l];
+                        p.hit[l] = n.offset + (unsigned int)(sphere[l] - first);
+                    }
+            }
+            for (unsigned int q = n.offset + n.spheres; q < n.offset + n.count; ++q)
+            {
+                RTR_STAT(stats.tests[prims.type(q)] += size);
+                prims.intersect(q, p, size, d);
+                for (size_t l = 0; l < size; ++l)
+                    if (((active >> l) & 1) && (d[l] > 0) && (d[l] < p.t[l]))
+                    {
+                        p.t[l] = d[l];
+                        p.hit[l] = q;
+                    }
+            }
+        }
+        if (!top) break;
+        i = stack[--top];
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Portable box kernel, the reference for the SIMD ones.
+///
+/// RETURNS: bit l set when lane l meets the box in (0, t).
+////////////////////////////////////////////////////////////
+unsigned long long boxPacketScalar(const BoxPacket& p, const Real* lo, const Real* hi)
+{
+    unsigned long long mask = 0;
+    for (size_t l = 0; l < p.lanes; ++l)
+    {
+        const Real inv[3] = { p.ix[l], p.iy[l], p.iz[l] };
+        Real tmin = 0.0, tmax = p.t[l];
+        for (int a = 0; a < 3; ++a)
+        {
+            Real t0 = lo[a] * inv[a], t1 = hi[a] * inv[a];
+            if (t0 > t1) std::swap(t0, t1);
+            if (t0 > tmin) tmin = t0;
+            if (t1 < tmax) tmax = t1;
+        }
+        if (tmin <= tmax) mask |= 1ull << l;
+    }
+    return mask;
+}
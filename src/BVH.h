@@ -0,0 +1,136 @@
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <vector>
+#include <memory>
+#include "Algebra.h"
+#include "Memory.h"
+#include "Primitives.h"
+
+class BaseObject;
+class ThreadPool;
+
+////////////////////////////////////////////////////////////
+/// Lanes of a packet for the box kernels: inverse of each
+/// lane's direction and its current limit. Lanes are a
+/// multiple of SPHERE_LANES, at most 64.
+////////////////////////////////////////////////////////////
+struct BoxPacket
+{
+    size_t lanes;
+    const Real *ix, *iy, *iz;
+    const Real* t;
+};
+
+/* lane bit mask of the lanes meeting a box; lo and hi are its corners minus the shared origin */
+unsigned long long boxPacketScalar(const BoxPacket& p, const Real* lo, const Real* hi);
+#ifdef SIMD_X86
+unsigned long long boxPacketSSE2(const BoxPacket& p, const Real* lo, const Real* hi);
+unsigned long long boxPacketAVX2(const BoxPacket& p, const Real* lo, const Real* hi);
+#endif
+#ifdef SIMD_AVX512
+unsigned long long boxPacketAVX512(const BoxPacket& p, const Real* lo, const Real* hi);
+#endif
+
+/* counting statements, removed from builds with RTR_NO_STATS */
+#ifdef RTR_NO_STATS
+#define RTR_STAT(statement)
+#else
+#define RTR_STAT(statement) statement
+#endif
+
+////////////////////////////////////////////////////////////
+/// Work of the traversals of one worker. A lane of a packet
+/// counts as one test of each prim its packet is tested
+/// against.
+////////////////////////////////////////////////////////////
+struct TraversalStats
+{
+    unsigned long long nodes;                   // boxes tested
+    unsigned long long tests[PrimObject + 1];   // prims tested, by PrimType
+    TraversalStats();
+    TraversalStats& operator += (const TraversalStats& s);
+};
+
+////////////////////////////////////////////////////////////
+/// Bounding volume hierarchy over the objects of a scene,
+/// answering closest hit and any hit queries in about
+/// logarithmic time instead of testing every object.
+////////////////////////////////////////////////////////////
+class BVH
+{
+public:
+    enum Mode
+    {
+        Median,                 // fast, splits at the median centre
+        SAH                     // slower, binned surface area heuristic
+    };
+    struct Stats
+    {
+        double buildMs;         // wall time of the last build
+        size_t nodes, leaves;
+        size_t depth;           // levels of the deepest leaf
+        double sahCost;         // expected cost of a ray, relative to one intersection
+    };
+    ////////////////////////////////////////////////////////
+    /// Nodes are laid out depth first in one array, so the
+    /// first child of an inner node is the next node and
+    /// only the second one needs an index.
+    ////////////////////////////////////////////////////////
+    struct alignas(32) Node
+    {
+        float min[3], max[3];   // bounds, rounded outwards
+        unsigned int offset;    // second child of an inner node, first prim of a leaf
+        unsigned short count;   // prims of a leaf, 0 for inner nodes
+        unsigned char axis;     // split axis of an inner node
+        unsigned char spheres;  // leading prims of a leaf that are spheres, the rest follow by type
+    };
+    BVH();
+    void build(const std::vector<BaseObject*>& objects, const Mode mode = SAH, ThreadPool* pool = nullptr,
+        const SimdLevel simd = SimdAVX512);
+    const Stats& stats() const { return info; }
+    const PrimitiveStore& primitives() const { return prims; }
+    bool closestHit(const Ray& r, const unsigned int skip, HitRecord& hit, TraversalStats& stats) const;
+    unsigned int anyHit(const Ray& r, const unsigned int skip, TraversalStats& stats) const;
+    void closestHit(RayPacket& p, TraversalStats& stats) const;
+    bool save(CacheWriter& out) const;
+    bool attach(CacheReader& in);
+    bool validate(const SimdLevel simd);
+private:
+    struct Build                // node of the tree while it is built
+    {
+        BBox box;
+        std::unique_ptr<Build> left, right;
+        size_t first, count;    // range of refs, count is 0 for inner nodes
+        int axis;
+    };
+    struct Ref
+    {
+        BaseObject* object;
+        unsigned int part;      // triangle of a mesh, 0 otherwise
+        unsigned char type;     // its PrimType
+        BBox box;
+        Vec3d centre;
+    };
+    struct Task                 // subtree left for the pool
+    {
+        Build* node;
+        size_t first, last, depth;
+    };
+    Storage<Node, AlignedAllocator<Node> > nodes;
+    PrimitiveStore prims;       // slot per prim, in leaf order
+    unsigned long long(*boxes)(const BoxPacket&, const Real*, const Real*);
+    std::vector<Ref> refs;
+    Mode mode;
+    Stats info;
+    void enclose(BBox& box, BBox& centres, const size_t first, const size_t last, ThreadPool* pool) const;
+    void split(Build& n, const size_t first, const size_t last, const size_t depth, ThreadPool* pool, std::vector<Task>* deferred);
+    size_t median(const BBox& centres, const size_t first, const size_t last, int& axis);
+    size_t binned(const Build& n, const BBox& centres, const size_t first, const size_t last, int& axis, ThreadPool* pool);
+    unsigned int flatten(const Build& n);
+    void gather();
+    void measure(const unsigned int n, const size_t depth, const double area);
+    void select(const SimdLevel simd);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "Framebuffer.h"        /* self definition */
+
+size_t pixelSize(const PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelRGB8:
+        return 3;
+    case PixelRGBA32F:
+        return 4 * sizeof(float);
+    default:
+        return 4;
+    }
+}
+
+Framebuffer::Framebuffer() :
+    base(nullptr), w(0), h(0), fmt(PixelRGBA8), rowStride(0)
+{
+}
+
+Framebuffer::Framebuffer(const int width, const int height, const PixelFormat format, const size_t stride) :
+    base(nullptr), w(0), h(0), fmt(PixelRGBA8), rowStride(0)
+{
+    resize(width, height, format, stride);
+}
+
+/* an empty frame, 0 by 0, which capture renders nothing into */
+void Framebuffer::clear(const PixelFormat format)
+{
+    base = nullptr;
+    w = h = 0;
+    fmt = format;
+    rowStride = 0;
+}
+
+////////////////////////////////////////////////////////////
+/// Setting the frame up in memory of its own, detaching
+/// from the caller's. Frames no larger than any before
+/// reuse the memory already there.
+///
+/// RETURNS: false, leaving the frame empty, when stride is
+///          shorter than a row of pixels; true otherwise.
+////////////////////////////////////////////////////////////
+bool Framebuffer::resize(const int width, const int height, const PixelFormat format, const size_t stride)
+{
+    const size_t row = size_t(width > 0 ? width : 0) * pixelSize(format);
+    if (stride && stride < row)
+    {
+        clear(format);
+        return false;
+    }
+    w = width > 0 ? width : 0;
+    h = height > 0 ? height : 0;
+    fmt = format;
+    rowStride = stride ? stride : row;
+    storage.resize(rowStride * h);
+    base = storage.data();
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Rendering into pixels the caller owns and keeps alive,
+/// height rows of stride bytes; the memory of its own the
+/// frame had is kept for a later resize.
+///
+/// RETURNS: false, leaving the frame empty, when stride is
+///          shorter than a row of pixels or there are no
+///          pixels; true otherwise.
+////////////////////////////////////////////////////////////
+bool Framebuffer::attach(void* pixels, const int width, const int height, const PixelFormat format, const size_t stride)
+{
+    const size_t row = size_t(width > 0 ? width : 0) * pixelSize(format);
+    if ((stride && stride < row) || (!pixels && row && height > 0))
+    {
+        clear(format);
+        return false;
+    }
+    w = width > 0 ? width : 0;
+    h = height > 0 ? height : 0;
+    fmt = format;
+    rowStride = stride ? stride : row;
+    base = static_cast<unsigned char*>(pixels);
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef _FRAMEBUFFER_H_
+#define _FRAMEBUFFER_H_
+
+#include <stddef.h>
+#include <vector>
+#include "Memory.h"
+
+////////////////////////////////////////////////////////////
+/// Layouts of a pixel. 8 bit channels hold the light times
+/// 256 the way Renderer::capture always stored it; floats
+/// hold the light itself, unclamped.
+////////////////////////////////////////////////////////////
+enum PixelFormat
+{
+    PixelRGBA8,
+    PixelRGB8,
+    PixelRGBA32F
+};
+
+size_t pixelSize(const PixelFormat format);     // bytes
+
+////////////////////////////////////////////////////////////
+/// Pixels Renderer::capture renders into, row by row from
+/// the top, stride bytes from one row to the next. Either
+/// owns its memory, kept from frame to frame and only
+/// reallocated when a frame needs more, or renders into
+/// memory of the caller, such as a mapped texture. A
+/// stride shorter than a row is refused, leaving the frame
+/// empty.
+////////////////////////////////////////////////////////////
+class Framebuffer
+{
+public:
+    Framebuffer();
+    Framebuffer(const int width, const int height, const PixelFormat format = PixelRGBA8, const size_t stride = 0);
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator = (const Framebuffer&) = delete;
+    bool resize(const int width, const int height, const PixelFormat format = PixelRGBA8, const size_t stride = 0);
+    bool attach(void* pixels, const int width, const int height, const PixelFormat format = PixelRGBA8, const size_t stride = 0);
+    int width() const { return w; }
+    int height() const { return h; }
+    PixelFormat format() const { return fmt; }
+    size_t stride() const { return rowStride; }
+    unsigned char* data() { return base; }
+    const unsigned char* data() const { return base; }
+    unsigned char* row(const int y) { return base + y * rowStride; }
+    const unsigned char* row(const int y) const { return base + y * rowStride; }
+private:
+    std::vector<unsigned char, AlignedAllocator<unsigned char> > storage;
+    unsigned char* base;        // storage.data(), or the caller's pixels once attached
+    int w, h;
+    PixelFormat fmt;
+    size_t rowStride;           // 0 given - width * pixelSize, rows packed
+    void clear(const PixelFormat format);
+};
+
+#endif
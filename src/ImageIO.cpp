@@ -0,0 +1,252 @@
+#include "ImageIO.h"            /* self definition */
+#include "Timeline.h"
+#include <stdio.h>              /* fopen, fwrite */
+#include <string.h>             /* strrchr, memcpy */
+#include <ctype.h>              /* tolower */
+#include <vector>
+#include <algorithm>            /* nth_element, max_element, min, max */
+
+/* where the pixels of a frame lie: the columns capture returns, or the rows of a Framebuffer */
+struct FrameLayout
+{
+    const unsigned char* pixels;
+    size_t xStep, yStep;        // bytes from a pixel to the next one along x, along y
+    PixelFormat format;
+    int width, height;
+};
+
+static FrameLayout columns(const unsigned char* rgba, const int width, const int height)
+{
+    const FrameLayout f = { rgba, (size_t)height * 4, 4, PixelRGBA8, width, height };
+    return f;
+}
+
+/* RGB bytes of row y, left to right; floats as capture stores them in bytes, clamped */
+static void row(unsigned char* out, const FrameLayout& f, const int y)
+{
+    const unsigned char* p = f.pixels + y * f.yStep;
+    for (int x = 0; x < f.width; ++x, out += 3, p += f.xStep)
+    {
+        if (f.format != PixelRGBA32F)
+        {
+            out[0] = p[0];
+            out[1] = p[1];
+            out[2] = p[2];
+            continue;
+        }
+        float rgb[3];
+        memcpy(rgb, p, sizeof(rgb));
+        for (int c = 0; c < 3; ++c)
+            out[c] = (unsigned char)std::min(std::max(rgb[c] * 256.0f, 0.0f), 255.0f);
+    }
+}
+
+/* RGB floats of row y, left to right; bytes scaled to [0, 1] */
+static void row(float* out, const FrameLayout& f, const int y)
+{
+    const unsigned char* p = f.pixels + y * f.yStep;
+    for (int x = 0; x < f.width; ++x, out += 3, p += f.xStep)
+        if (f.format == PixelRGBA32F)
+            memcpy(out, p, 3 * sizeof(float));
+        else
+            for (int c = 0; c < 3; ++c)
+                out[c] = p[c] / 255.0f;
+}
+
+static bool writePPM(const char* path, const FrameLayout& f)
+{
+    const int width = f.width, height = f.height;
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    std::vector<unsigned char> line(3 * (size_t)width);
+    for (int y = 0; ok && y < height; ++y)
+    {
+        row(line.data(), f, y);
+        ok = fwrite(line.data(), 1, line.size(), file) == line.size();
+    }
+    return fclose(file) == 0 && ok;
+}
+
+////////////////////////////////////////////////////////////
+/// Portable float map: three little endian floats a pixel,
+/// rows from the bottom up.
+////////////////////////////////////////////////////////////
+static bool writePFM(const char* path, const FrameLayout& f)
+{
+    const int width = f.width, height = f.height;
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fprintf(file, "PF\n%d %d\n-1.0\n", width, height) > 0;
+    std::vector<float> values(3 * (size_t)width);
+    for (int y = height - 1; ok && y >= 0; --y)
+    {
+        row(values.data(), f, y);
+        ok = fwrite(values.data(), sizeof(float), values.size(), file) == values.size();
+    }
+    return fclose(file) == 0 && ok;
+}
+
+struct CrcTable
+{
+    unsigned int entries[256];
+    CrcTable()
+    {
+        for (unsigned int i = 0; i < 256; ++i)
+        {
+            unsigned int c = i;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+static unsigned int crc32(unsigned int crc, const unsigned char* p, const size_t n)
+{
+    static const CrcTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i)
+        crc = table.entries[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void putBig(std::vector<unsigned char>& out, const unsigned int v)
+{
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+/* length, type, data and CRC of a PNG chunk */
+static bool chunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> head;
+    putBig(head, (unsigned int)data.size());
+    head.insert(head.end(), type, type + 4);
+    std::vector<unsigned char> tail;
+    putBig(tail, crc32(crc32(0, head.data() + 4, 4), data.data(), data.size()));
+    return fwrite(head.data(), 1, head.size(), file) == head.size() &&
+        fwrite(data.data(), 1, data.size(), file) == data.size() &&
+        fwrite(tail.data(), 1, tail.size(), file) == tail.size();
+}
+
+////////////////////////////////////////////////////////////
+/// 8 bit RGB PNG. The scanlines go unfiltered into stored
+/// deflate blocks, which any decoder reads, wrapped in the
+/// zlib header and checksum IDAT expects.
+////////////////////////////////////////////////////////////
+static bool writePNG(const char* path, const FrameLayout& f)
+{
+    const int width = f.width, height = f.height;
+    const size_t stride = 1 + 3 * (size_t)width;
+    std::vector<unsigned char> raw(stride * height);
+    for (int y = 0; y < height; ++y)
+    {
+        raw[y * stride] = 0;                                    /* filter: none */
+        row(&raw[y * stride + 1], f, y);
+    }
+
+    std::vector<unsigned char> z;
+    z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    z.push_back(0x78);                                          /* deflate, 32K window */
+    z.push_back(0x01);
+    unsigned int a = 1, b = 0;
+    size_t done = 0;
+    do
+    {
+        const size_t n = raw.size() - done < 65535 ? raw.size() - done : 65535;
+        z.push_back(done + n == raw.size() ? 1 : 0);           /* stored, last block flag */
+        z.push_back((unsigned char)n);
+        z.push_back((unsigned char)(n >> 8));
+        z.push_back((unsigned char)~n);
+        z.push_back((unsigned char)(~n >> 8));
+        z.insert(z.end(), raw.begin() + done, raw.begin() + done + n);
+        for (size_t i = done; i < done + n; ++i)
+        {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        done += n;
+    } while (done < raw.size());
+    putBig(z, (b << 16) | a);                                   /* Adler-32 */
+
+    std::vector<unsigned char> header;
+    putBig(header, width);
+    putBig(header, height);
+    const unsigned char format[] = { 8, 2, 0, 0, 0 };          /* 8 bit RGB, no interlace */
+    header.insert(header.end(), format, format + 5);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    static const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    const bool ok = fwrite(signature, 1, 8, file) == 8 && chunk(file, "IHDR", header) &&
+        chunk(file, "IDAT", z) && chunk(file, "IEND", std::vector<unsigned char>());
+    return fclose(file) == 0 && ok;
+}
+
+static bool writeImage(const char* path, const FrameLayout& f)
+{
+    const TimelineSpan span("encode image");
+    const char* dot = strrchr(path, '.');
+    if (!dot || strlen(dot) != 4) return false;
+    char ext[4];
+    for (int i = 0; i < 4; ++i)
+        ext[i] = (char)tolower((unsigned char)dot[i]);
+    if (!strncmp(ext, ".ppm", 4)) return writePPM(path, f);
+    if (!strncmp(ext, ".png", 4)) return writePNG(path, f);
+    if (!strncmp(ext, ".pfm", 4)) return writePFM(path, f);
+    return false;
+}
+
+bool writePPM(const char* path, const unsigned char* rgba, const int width, const int height)
+{
+    return writePPM(path, columns(rgba, width, height));
+}
+
+bool writePNG(const char* path, const unsigned char* rgba, const int width, const int height)
+{
+    return writePNG(path, columns(rgba, width, height));
+}
+
+bool writePFM(const char* path, const unsigned char* rgba, const int width, const int height)
+{
+    return writePFM(path, columns(rgba, width, height));
+}
+
+bool writeImage(const char* path, const unsigned char* rgba, const int width, const int height)
+{
+    return writeImage(path, columns(rgba, width, height));
+}
+
+bool writeImage(const char* path, const Framebuffer& frame)
+{
+    const FrameLayout f = { frame.data(), pixelSize(frame.format()), frame.stride(), frame.format(), frame.width(), frame.height() };
+    return writeImage(path, f);
+}
+
+double heatmap(unsigned char* rgba, const float* cost, const int width, const int height)
+{
+    static const unsigned char ramp[][3] =     /* evenly spaced stops */
+    {
+        { 0, 0, 4 }, { 81, 18, 124 }, { 183, 55, 121 }, { 252, 137, 97 }, { 252, 253, 191 }
+    };
+    const int stops = sizeof(ramp) / sizeof(ramp[0]);
+    const size_t count = (size_t)width * height;
+    if (!count) return 0;
+    std::vector<float> sorted(cost, cost + count);
+    std::nth_element(sorted.begin(), sorted.begin() + count * 99 / 100, sorted.end());
+    double scale = sorted[count * 99 / 100];
+    if (scale <= 0) scale = *std::max_element(cost, cost + count);
+    for (size_t i = 0; i < count; ++i, rgba += 4)
+    {
+        const double v = scale > 0 ? std::min(std::max(cost[i] / scale, 0.0), 1.0) * (stops - 1) : 0;
+        const int s = std::min(int(v), stops - 2);
+        const double f = v - s;
+        for (int c = 0; c < 3; ++c)
+            rgba[c] = (unsigned char)(ramp[s][c] + (ramp[s + 1][c] - ramp[s][c]) * f + 0.5);
+        rgba[3] = 255;
+    }
+    return scale;
+}
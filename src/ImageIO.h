@@ -0,0 +1,46 @@
+#ifndef _IMAGEIO_H_
+#define _IMAGEIO_H_
+
+#include "Framebuffer.h"
+
+////////////////////////////////////////////////////////////
+/// Writing a frame of Renderer::capture to disk: RGBA bytes
+/// stored column by column, the first row at the top. The
+/// alpha channel is dropped. PNG is written uncompressed,
+/// trading size for a writer with no dependencies; PFM
+/// holds the bytes scaled to [0, 1].
+///
+/// RETURNS: false when the file cannot be written.
+////////////////////////////////////////////////////////////
+bool writePPM(const char* path, const unsigned char* rgba, const int width, const int height);
+bool writePNG(const char* path, const unsigned char* rgba, const int width, const int height);
+bool writePFM(const char* path, const unsigned char* rgba, const int width, const int height);
+
+////////////////////////////////////////////////////////////
+/// Writing a frame in the format its extension names,
+/// .ppm, .png or .pfm, case ignored.
+///
+/// RETURNS: false for another extension or when the file
+///          cannot be written.
+////////////////////////////////////////////////////////////
+bool writeImage(const char* path, const unsigned char* rgba, const int width, const int height);
+
+////////////////////////////////////////////////////////////
+/// Writing a Framebuffer the same way, in any format. A
+/// float frame is clamped to 8 bits for .ppm and .png and
+/// written as it is to .pfm, light above 1 included.
+////////////////////////////////////////////////////////////
+bool writeImage(const char* path, const Framebuffer& frame);
+
+////////////////////////////////////////////////////////////
+/// Painting per pixel costs, stored like a frame, as a
+/// false colour frame: black through purple and orange to
+/// pale yellow. The scale is linear up to the 99th
+/// percentile, so that a few very slow pixels do not leave
+/// the rest black; costs above it are clamped.
+///
+/// RETURNS: the cost shown at full scale.
+////////////////////////////////////////////////////////////
+double heatmap(unsigned char* rgba, const float* cost, const int width, const int height);
+
+#endif
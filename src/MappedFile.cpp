@@ -0,0 +1,99 @@
+#include "MappedFile.h"         /* self definition */
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>            /* CreateFileMappingA, MapViewOfFile */
+#else
+#include <sys/mman.h>           /* mmap, munmap, madvise */
+#include <sys/stat.h>           /* fstat */
+#include <fcntl.h>              /* open */
+#include <unistd.h>             /* close */
+#endif
+
+MappedFile::MappedFile() :
+    view(nullptr), length(0), opened(false)
+#ifdef _WIN32
+    , file(INVALID_HANDLE_VALUE), mapping(nullptr)
+#else
+    , fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////
+/// Mapping the whole of a file, read only. Empty files
+/// open fine but have no view.
+///
+/// RETURNS: true when the file is mapped; false otherwise.
+////////////////////////////////////////////////////////////
+bool MappedFile::open(const char* path)
+{
+    close();
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        close();
+        return false;
+    }
+    length = (size_t)size.QuadPart;
+    if (length)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        view = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view)
+        {
+            close();
+            return false;
+        }
+    }
+#else
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st))
+    {
+        close();
+        return false;
+    }
+    length = (size_t)st.st_size;
+    if (length)
+    {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+        view = (const char*)p;
+    }
+#endif
+    opened = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (view) munmap((void*)view, length);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    view = nullptr;
+    length = 0;
+    opened = false;
+}
@@ -0,0 +1,35 @@
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+#include <stddef.h>
+
+////////////////////////////////////////////////////////////
+/// Read only view of a whole file mapped into memory, so
+/// loaders parse it in place without reading it into a
+/// buffer first. Pages come in as they are touched.
+////////////////////////////////////////////////////////////
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+    bool open(const char* path);    // closes the current file first
+    void close();
+    bool isOpen() const { return opened; }
+    const char* data() const { return view; }   // nullptr for an empty file
+    size_t size() const { return length; }
+private:
+    const char* view;
+    size_t length;
+    bool opened;
+#ifdef _WIN32
+    void* file;                 // HANDLEs, kept out of this header
+    void* mapping;
+#else
+    int fd;
+#endif
+};
+
+#endif
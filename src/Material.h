@@ -0,0 +1,15 @@
+#ifndef _MATERIAL_H_
+#define _MATERIAL_H_
+
+#include "Algebra.h"
+
+struct Material
+{
+    Vec3r ambient;            // 环境反射 - coefs of ambient reflection
+    Vec3r diffuse;            // 漫反射 - coefs of diffuse reflection
+    Real specular;             // 镜面反射 - coef of specular reflection
+    Real exponent;             // 镜面反射系数 - specular exponent
+    Real reflect;              // 递归光线 - recursive ray
+};
+
+#endif
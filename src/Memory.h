@@ -0,0 +1,124 @@
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>                  /* bad_alloc */
+#include <vector>
+#include <memory>               /* allocator */
+#ifdef _MSC_VER
+#include <malloc.h>             /* _aligned_malloc */
+#endif
+
+#define CACHE_LINE 64
+
+////////////////////////////////////////////////////////////
+/// Allocator handing out blocks aligned to Align bytes, so
+/// std::vector can hold cache line or SIMD aligned data.
+////////////////////////////////////////////////////////////
+template <class T, size_t Align = CACHE_LINE>
+class AlignedAllocator
+{
+public:
+    typedef T value_type;
+    template <class U> struct rebind { typedef AlignedAllocator<U, Align> other; };
+    AlignedAllocator() = default;
+    template <class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(const size_t n)
+    {
+        void* p = nullptr;
+#ifdef _MSC_VER
+        p = _aligned_malloc(n * sizeof(T), Align);
+#else
+        if (posix_memalign(&p, Align, n * sizeof(T))) p = nullptr;
+#endif
+        if (!p && n) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, const size_t)
+    {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    template <class U> bool operator == (const AlignedAllocator<U, Align>&) const { return true; }
+    template <class U> bool operator != (const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+////////////////////////////////////////////////////////////
+/// Array owning its elements while it is built, or viewing
+/// ones it does not own, such as the arrays of a mapped
+/// scene cache. Readers go through the same pointer either
+/// way; anything that changes a view copies it first.
+////////////////////////////////////////////////////////////
+template <class T, class Alloc = std::allocator<T> >
+class Storage
+{
+public:
+    Storage() : first(nullptr), count(0), external(false) {}
+    Storage(const Storage& s) : items(s.items), first(s.first), count(s.count), external(s.external)
+    {
+        if (!external) sync();
+    }
+    Storage& operator = (const Storage& s)
+    {
+        items = s.items;
+        first = s.first;
+        count = s.count;
+        external = s.external;
+        if (!external) sync();
+        return *this;
+    }
+    void view(const T* data, const size_t size)     // drops the owned elements
+    {
+        std::vector<T, Alloc>().swap(items);
+        first = data;
+        count = size;
+        external = true;
+    }
+    bool viewing() const { return external; }
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+    const T* data() const { return first; }
+    const T& operator [] (const size_t i) const { return first[i]; }
+    const T* begin() const { return first; }
+    const T* end() const { return first + count; }
+
+    T& operator [] (const size_t i) { return own()[i]; }
+    T* begin() { return own().data(); }
+    T* end() { return own().data() + count; }
+    T& back() { return own().back(); }
+    void reserve(const size_t n) { own().reserve(n); sync(); }
+    void resize(const size_t n) { own().resize(n); sync(); }
+    void assign(const size_t n, const T& v) { own().assign(n, v); sync(); }
+    void clear() { own().clear(); sync(); }
+    void push_back(const T& v) { own().push_back(v); sync(); }
+    template <class It> void append(It from, It to) { own().insert(items.end(), from, to); sync(); }
+private:
+    std::vector<T, Alloc> items;
+    const T* first;             // items.data() unless viewing
+    size_t count;
+    bool external;
+    std::vector<T, Alloc>& own()
+    {
+        if (external)
+        {
+            items.assign(first, first + count);
+            external = false;
+            sync();
+        }
+        return items;
+    }
+    void sync()
+    {
+        first = items.data();
+        count = items.size();
+    }
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include "ObjLoader.h"          /* self definition */
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Trace.h"              /* TriangleMesh */
+#include "TextParse.h"
+#include "Timeline.h"
+#include <limits.h>             /* UINT_MAX, LLONG_MAX */
+#include <chrono>               /* steady_clock */
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#define OBJ_CHUNK (4 << 20)     /* bytes of file per parallel task */
+
+////////////////////////////////////////////////////////////
+/// Run of whole lines of the file. The first pass counts
+/// what it holds, the second one parses it straight into
+/// the mesh, from where the chunks before it stopped.
+////////////////////////////////////////////////////////////
+struct ObjChunk
+{
+    const char *begin, *end;
+    size_t vertices, triangles;         // counted by the first pass
+    size_t firstVertex, firstTriangle;  // of the whole file, before the chunk
+};
+
+////////////////////////////////////////////////////////////
+/// Kind of the keyword starting a line: 'v' for positions,
+/// 'f' for faces, 0 for everything else.
+////////////////////////////////////////////////////////////
+static inline char keyword(const char*& p, const char* end)
+{
+    p = skipSpaces(p, end);
+    if (end - p < 2 || !isSpace(p[1])) return 0;
+    if (*p != 'v' && *p != 'f') return 0;
+    return *(p++);
+}
+
+////////////////////////////////////////////////////////////
+/// Parsing the vertex index of a face corner, skipping its
+/// texture and normal indices.
+///
+/// RETURNS: The end of the corner, nullptr if malformed.
+////////////////////////////////////////////////////////////
+static const char* parseCorner(const char* p, const char* end, long long& index)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *(p++) == '-';
+    if (p >= end || *p < '0' || *p > '9') return nullptr;
+    long long i = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        if (i < LLONG_MAX / 10) i = i * 10 + (*p - '0');
+    index = negative ? -i : i;
+    return tokenEnd(p, end);                                    /* /vt/vn */
+}
+
+static void countChunk(ObjChunk& c)
+{
+    c.vertices = c.triangles = 0;
+    for (const char* p = c.begin; p < c.end; p = nextLine(p, c.end))
+    {
+        const char* q = p;
+        switch (keyword(q, c.end))
+        {
+        case 'v':
+            ++c.vertices;
+            break;
+        case 'f':
+        {
+            size_t corners = 0;
+            for (q = skipSpaces(q, c.end); q < c.end && !isLineEnd(*q); q = skipSpaces(q, c.end))
+            {
+                ++corners;
+                q = tokenEnd(q, c.end);
+            }
+            if (corners > 2) c.triangles += corners - 2;
+            break;
+        }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// RETURNS: false at the first malformed line or corner
+///          out of [0, vertices).
+////////////////////////////////////////////////////////////
+static bool parseChunk(const ObjChunk& c, Vec3f* positions, unsigned int* indices, const size_t vertices)
+{
+    size_t vertex = c.firstVertex;
+    unsigned int* index = indices + 3 * c.firstTriangle;
+    for (const char* p = c.begin; p < c.end; p = nextLine(p, c.end))
+    {
+        const char* q = p;
+        switch (keyword(q, c.end))
+        {
+        case 'v':
+        {
+            double xyz[3];
+            for (int i = 0; i < 3; ++i)
+                if (!(q = parseNumber(skipSpaces(q, c.end), c.end, xyz[i]))) return false;
+            positions[vertex++] = Vec3f(float(xyz[0]), float(xyz[1]), float(xyz[2]));
+            break;
+        }
+        case 'f':
+        {
+            unsigned int first = 0, previous = 0;
+            size_t corners = 0;
+            for (q = skipSpaces(q, c.end); q < c.end && !isLineEnd(*q); q = skipSpaces(q, c.end), ++corners)
+            {
+                long long i;
+                if (!(q = parseCorner(q, c.end, i)) || !i) return false;
+                i = i > 0 ? i - 1 : (long long)vertex + i;     /* 1 based, or back from the last vertex */
+                if (i < 0 || i >= (long long)vertices) return false;
+                if (corners >= 2)                           /* fan around the first corner */
+                {
+                    index[0] = first;
+                    index[1] = previous;
+                    index[2] = (unsigned int)i;
+                    index += 3;
+                }
+                else if (!corners)
+                    first = (unsigned int)i;
+                previous = (unsigned int)i;
+            }
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+double ObjStats::throughput() const
+{
+    return ms > 0.0 ? bytes / (ms * 1000.0) : 0.0;
+}
+
+////////////////////////////////////////////////////////////
+/// Cutting the file into chunks of whole lines, counting
+/// each one, then parsing each one at the offsets the
+/// counts give, so the mesh buffers are sized once and
+/// filled in place.
+////////////////////////////////////////////////////////////
+bool loadObj(TriangleMesh& mesh, const char* path, ThreadPool* pool, ObjStats* stats)
+{
+    const TimelineSpan span("load obj");
+    const auto started = std::chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(path)) return false;
+    const char *data = file.data(), *end = data + file.size();
+
+    std::vector<ObjChunk> chunks;
+    for (const char* p = data; p < end;)
+    {
+        ObjChunk c;
+        c.begin = p;
+        c.end = end - p > OBJ_CHUNK ? nextLine(p + OBJ_CHUNK, end) : end;
+        chunks.push_back(c);
+        p = c.end;
+    }
+    const auto each = [&](const std::function<void(ObjChunk&)>& f)
+    {
+        if (pool && chunks.size() > 1)
+            pool->run(chunks.size(), [&](const size_t task, const size_t) { f(chunks[task]); });
+        else
+            for (ObjChunk& c : chunks)
+                f(c);
+    };
+
+    each(countChunk);
+    size_t vertices = 0, triangles = 0;
+    for (ObjChunk& c : chunks)
+    {
+        c.firstVertex = vertices;
+        c.firstTriangle = triangles;
+        vertices += c.vertices;
+        triangles += c.triangles;
+    }
+    if (vertices > UINT_MAX || 3 * triangles > UINT_MAX) return false;
+
+    mesh.positions.resize(vertices);
+    mesh.indices.resize(3 * triangles);
+    std::atomic<bool> ok(true);
+    each([&](ObjChunk& c)
+    {
+        if (!parseChunk(c, mesh.positions.data(), mesh.indices.data(), vertices)) ok = false;
+    });
+    if (!ok)
+    {
+        mesh.positions.clear();
+        mesh.indices.clear();
+        return false;
+    }
+
+    if (stats)
+    {
+        stats->ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        stats->bytes = file.size();
+        stats->vertices = vertices;
+        stats->triangles = triangles;
+    }
+    return true;
+}
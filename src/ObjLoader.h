@@ -0,0 +1,33 @@
+#ifndef _OBJLOADER_H_
+#define _OBJLOADER_H_
+
+#include <stddef.h>
+
+class TriangleMesh;
+class ThreadPool;
+
+////////////////////////////////////////////////////////////
+/// Figures of one OBJ load.
+////////////////////////////////////////////////////////////
+struct ObjStats
+{
+    double ms;                  // wall time, mapping the file included
+    size_t bytes;               // size of the file
+    size_t vertices, triangles;
+    double throughput() const;  // MB/s
+};
+
+////////////////////////////////////////////////////////////
+/// Loading the positions and faces of a Wavefront OBJ file
+/// into a mesh, replacing its buffers; faces of more than
+/// three vertices are split into fans. Texture coordinates,
+/// normals, groups and materials are skipped. With a pool,
+/// chunks of the file are parsed in parallel.
+///
+/// RETURNS: true when loaded; false when the file cannot
+///          be mapped or a face is malformed or refers to a
+///          vertex that does not exist.
+////////////////////////////////////////////////////////////
+bool loadObj(TriangleMesh& mesh, const char* path, ThreadPool* pool = nullptr, ObjStats* stats = nullptr);
+
+#endif
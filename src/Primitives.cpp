@@ -0,0 +1,301 @@
+#include "Primitives.h"         /* self definition */
+#include "Trace.h"              /* BaseObject, Sphere, TPolygon, TriangleMesh */
+#include "SceneCache.h"
+#include <string.h>             /* memcmp */
+#include <unordered_map>        /* unordered_map */
+
+////////////////////////////////////////////////////////////
+/// Finding intersections of the first lanes of a packet
+/// with a polygon. The distance from the shared origin to
+/// the plane is computed once for all of them; lanes only
+/// test the edges when the plane is hit within (0, p.t).
+////////////////////////////////////////////////////////////
+void polygonHit(const Vec3r& normal, const Vec3r& vertex, const Plane<Real>* edges, const size_t count,
+    const RayPacket& p, const size_t lanes, Real* t)
+{
+    const Real num = (vertex - p.start).dot(normal);
+    for (size_t l = 0; l < lanes; ++l)
+    {
+        const Real s2 = p.dx[l] * normal.x + p.dy[l] * normal.y + p.dz[l] * normal.z;
+        t[l] = s2 == 0.0 ? -1.0 : num / s2;
+    }
+    for (size_t l = 0; l < lanes; ++l)
+        if (t[l] <= 0.0 || t[l] >= p.t[l])
+            t[l] = -1.0;
+        else
+        {
+            const Vec3r a(p.start.x + p.dx[l] * t[l], p.start.y + p.dy[l] * t[l], p.start.z + p.dz[l] * t[l]);
+            for (size_t i = 0; i < count; ++i)
+                if (edges[i].vertexOnPlane(a) > 0.0)
+                {
+                    t[l] = -1.0;
+                    break;
+                }
+        }
+}
+
+const unsigned int PrimitiveStore::none;
+
+PrimType PrimitiveStore::typeOf(const BaseObject* o)
+{
+    if (dynamic_cast<const Sphere*>(o)) return PrimSphere;
+    if (dynamic_cast<const TPolygon*>(o)) return PrimPolygon;
+    if (dynamic_cast<const TriangleMesh*>(o)) return PrimTriangle;
+    return PrimObject;
+}
+
+/* materials compared and hashed by their bytes, all of them Reals */
+struct MaterialBytes
+{
+    size_t operator()(const Material& m) const
+    {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(&m);
+        unsigned long long h = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(Material); ++i)
+            h = (h ^ b[i]) * 1099511628211ull;
+        return (size_t)h;
+    }
+    bool operator()(const Material& a, const Material& b) const
+    {
+        return !memcmp(&a, &b, sizeof(Material));
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// Copying the prims into the arrays of their types, and
+/// their materials once per distinct material. Objects have
+/// to be initialized. Meshes are not copied: their
+/// triangles point into the mesh's buffers, which must
+/// outlive the store.
+////////////////////////////////////////////////////////////
+void PrimitiveStore::assign(const std::vector<PrimRef>& refs)
+{
+    const size_t size = refs.size();
+    size_t count = 0;                                   /* spheres so far */
+    std::unordered_map<Material, unsigned int, MaterialBytes, MaterialBytes> materialIdOf;
+    std::unordered_map<const BaseObject*, unsigned int> meshOf;
+    const BaseObject* last = nullptr;                   /* object of the previous slot, and its material */
+    unsigned int lastMaterial = 0;
+    const BaseObject* lastMesh = nullptr;               /* mesh of the previous triangle, and its index */
+    unsigned int mesh = 0;
+    objects.resize(size);
+    types.resize(size);
+    index.resize(size);
+    materialIds.resize(size);
+    materials.clear();
+    polygons.clear();
+    edges.clear();
+    meshes.clear();
+    triangles.clear();
+    for (const PrimRef& r : refs)
+        count += r.type == PrimSphere;
+    spheres.resize(count);
+    count = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        BaseObject* o = refs[i].object;
+        objects[i] = o;
+        types[i] = (unsigned char)refs[i].type;
+        if (o != last && (!last || memcmp(&o->material, &last->material, sizeof(Material))))
+        {
+            const auto m = materialIdOf.emplace(o->material, (unsigned int)materials.size());
+            if (m.second)
+                materials.push_back(o->material);
+            lastMaterial = m.first->second;
+        }
+        last = o;
+        materialIds[i] = lastMaterial;
+        index[i] = (unsigned int)i;
+        switch (types[i])
+        {
+        case PrimSphere:
+        {
+            const Sphere* s = static_cast<const Sphere*>(o);
+            index[i] = (unsigned int)count;
+            spheres.set(count++, s->centre, s->radius);
+            break;
+        }
+        case PrimPolygon:
+        {
+            const TPolygon* t = static_cast<const TPolygon*>(o);
+            const Polygon p = { t->inormal, t->vertices[0], (unsigned int)edges.size(), (unsigned int)t->edges.size() };
+            index[i] = (unsigned int)polygons.size();
+            polygons.push_back(p);
+            edges.append(t->edges.begin(), t->edges.end());
+            break;
+        }
+        case PrimTriangle:
+        {
+            if (o != lastMesh)
+            {
+                const auto n = meshOf.emplace(o, (unsigned int)meshes.size());
+                if (n.second)
+                {
+                    const TriangleMesh* t = static_cast<const TriangleMesh*>(o);
+                    const Mesh m = { t->positions.data(), t->indices.data(), t->positions.size(), t->indices.size() };
+                    meshes.push_back(m);
+                }
+                lastMesh = o;
+                mesh = n.first->second;
+            }
+            const Triangle t = { mesh, 3 * refs[i].part };
+            index[i] = (unsigned int)triangles.size();
+            triangles.push_back(t);
+            break;
+        }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Filling position, normal and material of the closest
+/// hit, once a traversal has found it.
+////////////////////////////////////////////////////////////
+void PrimitiveStore::complete(const Ray& r, HitRecord& hit) const
+{
+    const unsigned int slot = hit.prim;
+    hit.position = r.onRay(hit.t);
+    hit.material = materialIds[slot];
+    switch (types[slot])
+    {
+    case PrimSphere: hit.normal = spheres.normal(index[slot], hit.position); break;
+    case PrimPolygon: hit.normal = polygons[index[slot]].normal; break;
+    case PrimTriangle:
+    {
+        Vec3r a, b, c;
+        corners(slot, a, b, c);
+        hit.normal = (Vec3r(a, b) * Vec3r(a, c)).unit();
+        break;
+    }
+    default: hit.normal = objects[slot]->normal(hit.position); break;
+    }
+}
+
+void PrimitiveStore::intersect(const unsigned int slot, const RayPacket& p, const size_t lanes, Real* t) const
+{
+    if (types[slot] == PrimPolygon)
+    {
+        const Polygon& q = polygons[index[slot]];
+        polygonHit(q.normal, q.vertex, edges.data() + q.edge, q.edges, p, lanes, t);
+    }
+    else if (types[slot] == PrimTriangle)
+    {
+        Vec3r a, b, c;
+        corners(slot, a, b, c);
+        for (size_t l = 0; l < lanes; ++l)
+            t[l] = triangleHit(a, b, c, p.ray(l));
+    }
+    else
+        objects[slot]->intersect(p, lanes, t);
+}
+
+Real PrimitiveStore::objectHit(const unsigned int slot, const Ray& r) const
+{
+    return objects[slot]->intersect(r);
+}
+
+////////////////////////////////////////////////////////////
+/// Writing the arrays of the store, the buffers of each
+/// mesh included, to a scene cache.
+///
+/// RETURNS: false when a prim only exists as an object,
+///          which cannot be cached; true otherwise.
+////////////////////////////////////////////////////////////
+bool PrimitiveStore::save(CacheWriter& out) const
+{
+    for (const unsigned char t : types)
+        if (t == PrimObject) return false;
+    out.put(types);
+    out.put(index);
+    out.put(materialIds);
+    out.put(materials);
+    out.put(polygons);
+    out.put(edges);
+    out.put(triangles);
+    out.value((unsigned long long)meshes.size());
+    for (const Mesh& m : meshes)
+    {
+        out.put(m.positions, m.vertices);
+        out.put(m.indices, m.count);
+    }
+    spheres.save(out);
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Viewing the arrays of a scene cache in place of the
+/// store's own. Only their lengths are checked here; what
+/// they hold is checked by validate.
+///
+/// RETURNS: false when the cache ends early or an array
+///          does not have the expected element size.
+////////////////////////////////////////////////////////////
+bool PrimitiveStore::attach(CacheReader& in)
+{
+    unsigned long long count;
+    size_t sphereCount = 0;
+    objects.clear();
+    meshes.clear();
+    if (!in.get(types) || !in.get(index) || !in.get(materialIds) || !in.get(materials) ||
+        !in.get(polygons) || !in.get(edges) || !in.get(triangles) || !in.value(count))
+        return false;
+    for (unsigned long long i = 0; i < count; ++i)
+    {
+        Mesh m;
+        if (!in.get(m.positions, m.vertices) || !in.get(m.indices, m.count))
+            return false;
+        meshes.push_back(m);
+    }
+    for (const unsigned char t : types)
+        sphereCount += t == PrimSphere;
+    return index.size() == types.size() && materialIds.size() == types.size() &&
+        spheres.attach(in, sphereCount);
+}
+
+////////////////////////////////////////////////////////////
+/// Checking that every index of an attached store stays
+/// within the arrays it points into, so a damaged cache
+/// fails here rather than while tracing.
+///
+/// RETURNS: true when the store is safe to trace.
+////////////////////////////////////////////////////////////
+bool PrimitiveStore::validate() const
+{
+    const size_t size = types.size();
+    size_t sphere = 0;                              /* spheres are numbered in slot order */
+    if (index.size() != size || materialIds.size() != size)
+        return false;
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (materialIds[i] >= materials.size())
+            return false;
+        switch (types[i])
+        {
+        case PrimSphere:
+            if (index[i] != sphere++)
+                return false;
+            break;
+        case PrimPolygon:
+            if (index[i] >= polygons.size() ||
+                (size_t)polygons[index[i]].edge + polygons[index[i]].edges > edges.size())
+                return false;
+            break;
+        case PrimTriangle:
+            if (index[i] >= triangles.size() || triangles[index[i]].mesh >= meshes.size() ||
+                (size_t)triangles[index[i]].first + 3 > meshes[triangles[index[i]].mesh].count)
+                return false;
+            break;
+        default:
+            if (i >= objects.size() || !objects[i])
+                return false;
+            break;
+        }
+    }
+    if (sphere != spheres.size())
+        return false;
+    for (const Mesh& m : meshes)
+        for (size_t i = 0; i < m.count; ++i)
+            if (m.indices[i] >= m.vertices)
+                return false;
+    return true;
+}
@@ -0,0 +1,193 @@
+#ifndef _PRIMITIVES_H_
+#define _PRIMITIVES_H_
+
+#include <vector>
+#include "Algebra.h"
+#include "Ray.h"
+#include "Spheres.h"
+#include "Material.h"
+
+class BaseObject;
+
+enum PrimType
+{
+    PrimSphere,                 // in the sphere SoA
+    PrimPolygon,                // flattened into polygons and edges
+    PrimTriangle,               // one triangle of a TriangleMesh, read from its buffers
+    PrimObject                  // any other BaseObject, through its virtuals
+};
+
+////////////////////////////////////////////////////////////
+/// Finding intersection of a ray with a polygon lying in
+/// the plane of normal through vertex and bounded by the
+/// given edge planes.
+///
+/// RETURNS: Distance from the origine of the ray, -1 when
+///          the polygon is missed or hit outside (tmin, tmax).
+////////////////////////////////////////////////////////////
+FORCE_INLINE Real polygonHit(const Vec3r& normal, const Vec3r& vertex, const Plane<Real>* edges, const size_t count, const Ray& r)
+{
+    const Real s2 = r.direction.dot(normal);
+    if (s2 == 0.0)
+        return -1.0f;
+    const Real t = (vertex - r.start).dot(normal) / s2;
+    if (!r.within(t))                   /* the edges are only tested when it matters */
+        return -1.0;
+    const Vec3r a(r.onRay(t));
+    for (size_t i = 0; i < count; ++i)
+        if (edges[i].vertexOnPlane(a) > 0.0)
+            return -1.0;
+    return t;
+}
+
+void polygonHit(const Vec3r& normal, const Vec3r& vertex, const Plane<Real>* edges, const size_t count,
+    const RayPacket& p, const size_t lanes, Real* t);
+
+////////////////////////////////////////////////////////////
+/// Moller-Trumbore intersection of a ray with the triangle
+/// (a, b, c). Nothing is stored besides the corners: the
+/// barycentric coordinates of the hit come out of two
+/// cross products and a few dot products.
+///
+/// RETURNS: Distance from the origine of the ray, -1 when
+///          the triangle is missed or hit outside (tmin, tmax).
+////////////////////////////////////////////////////////////
+FORCE_INLINE Real triangleHit(const Vec3r& a, const Vec3r& b, const Vec3r& c, const Ray& r)
+{
+    const Vec3r e1(a, b), e2(a, c), p(r.direction * e2);
+    const Real det = e1.dot(p);
+    if (det == 0.0)                     /* parallel to the plane */
+        return -1.0;
+    const Real inv = 1 / det;
+    const Vec3r s(a, r.start);
+    const Real u = s.dot(p) * inv;
+    if (u < 0.0 || u > 1.0)
+        return -1.0;
+    const Vec3r q(s * e1);
+    const Real v = r.direction.dot(q) * inv;
+    if (v < 0.0 || u + v > 1.0)
+        return -1.0;
+    const Real t = e2.dot(q) * inv;
+    return r.within(t) ? t : -1.0;
+}
+
+////////////////////////////////////////////////////////////
+/// One prim handed to the store: an object, or a triangle
+/// of it when it is a mesh, with the type the BVH found.
+////////////////////////////////////////////////////////////
+struct PrimRef
+{
+    BaseObject* object;
+    unsigned int part;          // triangle of a mesh, 0 otherwise
+    PrimType type;              // typeOf(object)
+};
+
+////////////////////////////////////////////////////////////
+/// Result of a closest hit query. A traversal only sets t
+/// and prim while it looks for the closest prim; the rest
+/// is filled by PrimitiveStore::complete once it is found.
+////////////////////////////////////////////////////////////
+struct HitRecord
+{
+    Real t;                     // distance along the ray
+    unsigned int prim;          // slot hit, PrimitiveStore::none if none
+    unsigned int material;      // index into PrimitiveStore's materials
+    Vec3r position;
+    Vec3r normal;               // unit, facing out of the prim
+};
+
+////////////////////////////////////////////////////////////
+/// The prims of a scene by value, one array per type, in
+/// the order of the BVH leaves. A slot names one prim; the
+/// BaseObject it was made from stays the way scenes are
+/// built, and the fallback for types without an array.
+/// Stores without such prims can be saved to a scene cache
+/// and attached back to it, their arrays viewed in place.
+////////////////////////////////////////////////////////////
+class PrimitiveStore
+{
+public:
+    static const unsigned int none = ~0u;      // no slot
+    static PrimType typeOf(const BaseObject* o);
+    void assign(const std::vector<PrimRef>& refs);  // slot i holds refs[i]
+    size_t size() const { return types.size(); }
+    PrimType type(const unsigned int slot) const { return PrimType(types[slot]); }
+    size_t sphere(const unsigned int slot) const    // its place in spheres, SphereSoA::none if not a sphere
+    {
+        return slot < types.size() && types[slot] == PrimSphere ? index[slot] : SphereSoA::none;
+    }
+    BaseObject* object(const unsigned int slot) const { return objects[slot]; }
+    const Material& material(const unsigned int id) const { return materials[id]; }
+    void complete(const Ray& r, HitRecord& hit) const;
+    Real intersect(const unsigned int slot, const Ray& r) const;
+    void intersect(const unsigned int slot, const RayPacket& p, const size_t lanes, Real* t) const;
+    bool save(CacheWriter& out) const;
+    bool attach(CacheReader& in);
+    bool validate() const;
+    SphereSoA spheres;          // the spheres in the order of their slots
+private:
+    struct Polygon
+    {
+        Vec3r normal, vertex;   // plane of the polygon
+        unsigned int edge, edges;   // its run of edge planes
+    };
+    struct Mesh
+    {
+        const Vec3f* positions; // buffers of the TriangleMesh or the cache, not copied
+        const unsigned int* indices;
+        size_t vertices, count; // lengths of the buffers
+    };
+    struct Triangle
+    {
+        unsigned int mesh, first;   // its mesh and its first of three indices
+    };
+    Storage<unsigned char> types;
+    Storage<unsigned int> index;                // position of a slot in the array of its type
+    Storage<Polygon> polygons;
+    Storage<Plane<Real> > edges;
+    std::vector<Mesh> meshes;
+    Storage<Triangle> triangles;
+    std::vector<BaseObject*> objects;           // what each slot was made from, empty once attached
+    Storage<unsigned int> materialIds;          // material of each slot
+    Storage<Material> materials;                // the distinct materials of the objects
+    Real objectHit(const unsigned int slot, const Ray& r) const;
+    FORCE_INLINE void corners(const unsigned int slot, Vec3r& a, Vec3r& b, Vec3r& c) const
+    {
+        const Triangle& t = triangles[index[slot]];
+        const Mesh& m = meshes[t.mesh];
+        a = Vec3r(m.positions[m.indices[t.first]]);
+        b = Vec3r(m.positions[m.indices[t.first + 1]]);
+        c = Vec3r(m.positions[m.indices[t.first + 2]]);
+    }
+};
+
+////////////////////////////////////////////////////////////
+/// Finding intersection of a ray with the prim of a slot,
+/// from the arrays of its type, or through its object for
+/// types without one.
+///
+/// RETURNS: Distance from the origine of the ray.
+////////////////////////////////////////////////////////////
+FORCE_INLINE Real PrimitiveStore::intersect(const unsigned int slot, const Ray& r) const
+{
+    switch (types[slot])
+    {
+    case PrimSphere:
+        return spheres.intersect(index[slot], r);
+    case PrimPolygon:
+    {
+        const Polygon& p = polygons[index[slot]];
+        return polygonHit(p.normal, p.vertex, edges.data() + p.edge, p.edges, r);
+    }
+    case PrimTriangle:
+    {
+        Vec3r a, b, c;
+        corners(slot, a, b, c);
+        return triangleHit(a, b, c, r);
+    }
+    default:
+        return objectHit(slot, r);
+    }
+}
+
+#endif
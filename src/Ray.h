@@ -0,0 +1,84 @@
+#ifndef _RAY_H_
+#define _RAY_H_
+
+#include <stddef.h>
+#include <limits>               /* numeric_limits */
+#include "Algebra.h"
+
+/* farthest distance along the unit direction a hit is looked for at unless told otherwise: no limit */
+#define RAY_FAR std::numeric_limits<Real>::infinity()
+
+////////////////////////////////////////////////////////////
+/// Half line from start along a unit direction, with the
+/// interval (tmin, tmax) hits are looked for in. Inverse
+/// and sign of the direction are kept for the slab tests.
+////////////////////////////////////////////////////////////
+class Ray
+{
+public:
+    Vec3r start;              // origin of the ray 
+    Vec3r direction;          // unit vector along the ray
+    Vec3r inverse;            // 1 / direction, per component
+    bool negative[3];         // direction is negative along an axis
+    Real tmin, tmax;          // distances hits are looked for between
+    Ray() = default;
+    ////////////////////////////////////////////////////////
+    ///Constructing a ray from a point and a vector, which
+    ///does not need to be of unit length.
+    ////////////////////////////////////////////////////////
+    Ray(const Vec3r& from, const Vec3r& vector, const Real _tmax = RAY_FAR) :
+        start(from), tmin(0), tmax(_tmax)
+    {
+        aim(vector.unit());
+    }
+    ////////////////////////////////////////////////////////
+    ///Constructing a ray along a direction already of unit
+    ///length, as stored in a packet.
+    ////////////////////////////////////////////////////////
+    static Ray unit(const Vec3r& from, const Vec3r& direction, const Real tmax = RAY_FAR)
+    {
+        Ray r;
+        r.start = from;
+        r.tmin = 0;
+        r.tmax = tmax;
+        r.aim(direction);
+        return r;
+    }
+    ////////////////////////////////////////////////////////
+    ///Returns point at distance t from the origine.
+    ///
+    ///RETURNS: Constructed vertex
+    ////////////////////////////////////////////////////////
+    FORCE_INLINE Vec3r onRay(const Real f) const { return start + direction * f; }
+    FORCE_INLINE bool within(const Real t) const { return t > tmin && t < tmax; }
+private:
+    FORCE_INLINE void aim(const Vec3r& d)
+    {
+        direction = d;
+        inverse = Vec3r(1 / d.x, 1 / d.y, 1 / d.z);
+        negative[0] = d.x < 0;
+        negative[1] = d.y < 0;
+        negative[2] = d.z < 0;
+    }
+};
+
+#define PACKET_LANES 64         /* lanes of the largest, 8x8 packet */
+
+////////////////////////////////////////////////////////////
+/// Primary rays of a block of neighbouring pixels, traced
+/// together. They share the viewer as origin; the rest is
+/// one array per component so loops over lanes vectorize.
+////////////////////////////////////////////////////////////
+struct RayPacket
+{
+    size_t size;                                // lanes in use
+    Vec3r start;                                // origin of every lane
+    alignas(64) Real dx[PACKET_LANES];          // unit directions
+    alignas(64) Real dy[PACKET_LANES];
+    alignas(64) Real dz[PACKET_LANES];
+    alignas(64) Real t[PACKET_LANES];           // distance of the closest hit
+    unsigned int hit[PACKET_LANES];             // slot of the prim hit, ~0u if none
+    Ray ray(const size_t lane) const { return Ray::unit(start, Vec3r(dx[lane], dy[lane], dz[lane]), t[lane]); }
+};
+
+#endif
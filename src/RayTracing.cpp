@@ -1,4 +1,5 @@
 #include "Trace.h"
+#include "SceneFile.h"
 #include "Algebra.h"
 #include <GL/glew.h>
 #include <UILIb.h>
@@ -18,71 +19,24 @@ class Page0 : public Page
 private:
     Renderer w;
 public:
-    void PersetWorld()
+    ////////////////////////////////////////////////////////////
+    /// Loading the scene shown at start, or an empty one
+    /// seen from where the preset looks if it cannot be read.
+    ////////////////////////////////////////////////////////////
+    void loadWorld(const char* path)
     {
-        w.cameras.push_back(std::shared_ptr<Camera>(new Camera(Vec3d(0, 0, 500), Vec3d(0, 0, 0), Vec3d(1, 0, 0), Vec3d(0, 1, 0))));
+        if (loadScene(w, path) && !w.cameras.empty()) return;
+        w.cameras.clear();
+        w.cameras.push_back(std::shared_ptr<Camera>(new Camera(Vec3r(0, 0, 500), Vec3r(0, 0, 0), Vec3r(1, 0, 0), Vec3r(0, 1, 0))));
         w.scene = std::shared_ptr<Scene>(new Scene());
-        w.scene->ambient = Vec3d(0.1, 0.1, 0.1);
-
-        PointLight* l = new PointLight[2];
-
-        l[0].centre = Vec3d(-500, -50, -400);
-        l[0].intensity = Vec3d(0.4, 0.4, 0.4);
-        l[1].centre = Vec3d(300, -50, -400);
-        l[1].intensity = Vec3d(0.5, 0.5, 0.5);
-        w.scene->point_lights.push_back(l);
-        w.scene->point_lights.push_back(l + 1);
-
-        TPolygon * p = new TPolygon;
-        p->vertices.push_back(Vec3d(-300, 130, 300));
-        p->vertices.push_back(Vec3d(300, 130, 300));
-        p->vertices.push_back(Vec3d(300, 130, 0));
-        p->vertices.push_back(Vec3d(-300, 130, 0));
-        p->vertices.push_back(Vec3d(-300, 130, 300));
-        p->inormal = Vec3d(0, 0, 0);
-        p->material.ambient = Vec3d(0.6, 0.6, 0.6);
-        p->material.diffuse = Vec3d(0.6, 0.6, 0.6);
-        p->material.specular = 0.9;
-        p->material.exponent = 30;
-        p->material.reflect = 0.3;
-        w.scene->objects.push_back(p);
-
-        Sphere *s1 = new Sphere;
-        s1->radius = 75;
-        s1->centre = Vec3d(-100, -70, 500);
-        s1->material.ambient = Vec3d(1, 0.5, 0);
-        s1->material.diffuse = Vec3d(1, 0.5, 0);
-        s1->material.specular = 0.9;
-        s1->material.exponent = 30;
-        s1->material.reflect = 0.4;
-        w.scene->objects.push_back(s1);
-
-        Sphere *s2 = new Sphere;
-        s2->radius = 75;
-        s2->centre = Vec3d(90, 55, 120);
-        s2->material.ambient = Vec3d(1, 0, 0);
-        s2->material.diffuse = Vec3d(1, 0, 0);
-        s2->material.specular = 0.9;
-        s2->material.exponent = 30;
-        s2->material.reflect = 0.4;
-        w.scene->objects.push_back(s2);
-
-        Sphere *s3 = new Sphere;
-        s3->radius = 75;
-        s3->centre = Vec3d(-90, 55, 120);
-        s3->material.ambient = Vec3d(0, 1, 1);
-        s3->material.diffuse = Vec3d(0, 1, 1);
-        s3->material.specular = 0.6;
-        s3->material.exponent = 30;
-        s3->material.reflect = 0.3;
-        w.scene->objects.push_back(s3);
+        w.scene->ambient = Vec3r(0.1, 0.1, 0.1);
     }
     
     GLuint tex;
 
     Page0() : Page()
     {
-        PersetWorld();
+        loadWorld("scenes/preset.scene");
         w.init();
         content = std::make_shared<Grid>();
         unsigned char* Tex = w.capture(HW_SCREEN_X_SIZE, HW_SCREEN_Y_SIZE, 0);
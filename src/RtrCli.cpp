@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////
+/// Headless renderer: loads a scene file, renders one frame
+/// with the requested threads and writes it to disk, with
+/// no window or OpenGL context, for batch runs. With a
+/// scene cache the parsed and built scene is kept between
+/// runs.
+////////////////////////////////////////////////////////////
+#include "Trace.h"
+#include "SceneFile.h"
+#include "ImageIO.h"
+#include "ObjLoader.h"
+#include "Timeline.h"
+#include <stdio.h>              /* printf, fprintf */
+#include <stdlib.h>             /* atoi, atof, strtol */
+#include <string.h>             /* strcmp, strrchr */
+#include <errno.h>              /* errno, ERANGE */
+#include <limits.h>             /* INT_MAX */
+#include <string>
+#include <vector>
+#include <chrono>               /* steady_clock */
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: rtr [options] scene\n"
+        "       rtr [options] --cache file [scene]\n"
+        "  -o file       image to write, .png .ppm or .pfm (out.png)\n"
+        "  -w width      pixels (600)\n"
+        "  -h height     pixels (600)\n"
+        "  -t threads    0 - one per hardware thread (0)\n"
+        "  -d depth      reflections followed at most (10)\n"
+        "  -c camera     index of the camera to render from (0)\n"
+        "  -p packet     primary rays in packet^2 packets, 2 4 or 8, 0 - one by one (0)\n"
+        "  -s simd       widest kernels, 0 scalar 1 SSE2 2 AVX2 3 AVX-512 (what the CPU has)\n"
+        "  -b mode       BVH build, 0 median split 1 surface area heuristic (1)\n"
+        "  --cutoff w    weight under which reflections are dropped (1/256)\n"
+        "  --stats       print what the rays did, unless built without the counters\n"
+        "  --heatmap f   also write the cost of each pixel in false colour to f\n"
+        "  --cost what   cost the heatmap shows, cycles or tests (cycles)\n"
+        "  --timeline f  write the load, init, tiles and encoding of each thread to f,\n"
+        "                as Chrome trace JSON for chrome://tracing or ui.perfetto.dev\n"
+        "  --cache f     load the scene from cache f, or load the scene and save it to f;\n"
+        "                delete f after changing the scene or -b to build it again\n");
+}
+
+/* reading a whole argument as a count: digits only, from 0 up to INT_MAX */
+static bool count(const char* v, int& n)
+{
+    char* end;
+    errno = 0;
+    const long l = strtol(v, &end, 10);
+    if (end == v || *end || errno == ERANGE || l < 0 || l > INT_MAX)
+        return false;
+    n = (int)l;
+    return true;
+}
+
+static double since(const std::chrono::steady_clock::time_point& t)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+int main(int argc, char** argv)
+{
+    Renderer renderer;
+    const char *scenePath = nullptr, *out = "out.png", *heat = nullptr, *timeline = nullptr, *cachePath = nullptr;
+    int width = 600, height = 600, depth = 10, threads = 0, camera = 0;
+    bool counters = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (a[0] != '-')
+        {
+            scenePath = a;
+            continue;
+        }
+        if (!strcmp(a, "--stats"))
+        {
+            counters = true;
+            continue;
+        }
+        if (!v)
+        {
+            usage();
+            return 2;
+        }
+        ++i;
+        bool ok = true;
+        if (!strcmp(a, "-o")) out = v;
+        else if (!strcmp(a, "-w")) ok = count(v, width);
+        else if (!strcmp(a, "-h")) ok = count(v, height);
+        else if (!strcmp(a, "-t")) ok = count(v, threads);
+        else if (!strcmp(a, "-d")) ok = count(v, depth);
+        else if (!strcmp(a, "-c")) ok = count(v, camera);
+        else if (!strcmp(a, "-p"))
+            ok = count(v, renderer.packetSize) && (renderer.packetSize == 0 || renderer.packetSize == 2 ||
+                renderer.packetSize == 4 || renderer.packetSize == 8);
+        else if (!strcmp(a, "-s")) renderer.simd = SimdLevel(atoi(v));
+        else if (!strcmp(a, "-b")) renderer.bvhMode = BVH::Mode(atoi(v));
+        else if (!strcmp(a, "--cutoff")) renderer.cutoff = Real(atof(v));
+        else if (!strcmp(a, "--heatmap")) heat = v;
+        else if (!strcmp(a, "--timeline")) timeline = v;
+        else if (!strcmp(a, "--cache")) cachePath = v;
+        else if (!strcmp(a, "--cost") && (!strcmp(v, "cycles") || !strcmp(v, "tests")))
+            renderer.costMode = !strcmp(v, "tests") ? CostTests : CostCycles;
+        else
+            ok = false;
+        if (!ok)
+        {
+            usage();
+            return 2;
+        }
+    }
+    if ((!scenePath && !cachePath) || width <= 0 || height <= 0)
+    {
+        usage();
+        return 2;
+    }
+    renderer.threads = (size_t)threads;
+    if (heat && renderer.costMode == CostNone)
+        renderer.costMode = CostCycles;
+    if (timeline)
+    {
+        timelineNameThread("main, worker 0 of every pool");
+        timelineStart();
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::string error;
+    ObjStats obj = ObjStats();
+    std::shared_ptr<Scene> cached(new Scene);
+    const bool fromCache = cachePath && cached->load(cachePath, renderer.cameras);
+    if (fromCache)
+    {
+        renderer.scene = cached;
+        scenePath = cachePath;
+    }
+    else if (cachePath && !scenePath)
+    {
+        fprintf(stderr, "%s: cannot load the cache, and no scene to build it from\n", cachePath);
+        return 1;
+    }
+    else if (!loadScene(renderer, scenePath, &renderer.workers(), &error, &obj))     /* on the threads that render */
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if ((size_t)camera >= renderer.cameras.size())
+    {
+        fprintf(stderr, "%s: no camera %d\n", scenePath, camera);
+        return 1;
+    }
+    const double loadMs = since(started);
+
+    started = std::chrono::steady_clock::now();
+    if (!renderer.init())
+    {
+        fprintf(stderr, "%s: cannot prepare the scene\n", scenePath);
+        return 1;
+    }
+    const double initMs = since(started);
+    if (cachePath && !fromCache && !renderer.scene->save(cachePath, renderer.cameras))
+        fprintf(stderr, "%s: cannot save the scene cache\n", cachePath);
+
+    const char* dot = strrchr(out, '.');
+    const bool hdr = dot && (!strcmp(dot, ".pfm") || !strcmp(dot, ".PFM"));   /* float maps get the light unclamped */
+    Framebuffer frame(width, height, hdr ? PixelRGBA32F : PixelRGBA8);
+    started = std::chrono::steady_clock::now();
+    renderer.capture(frame, (size_t)camera, (size_t)depth);
+    const double renderMs = since(started);
+
+    started = std::chrono::steady_clock::now();
+    const bool written = writeImage(out, frame);
+    const double writeMs = since(started);
+    if (!written)
+    {
+        fprintf(stderr, "%s: cannot write, or not .png .ppm .pfm\n", out);
+        return 1;
+    }
+    double scale = 0;
+    if (heat)
+    {
+        std::vector<unsigned char> colours((size_t)width * height * 4);
+        scale = heatmap(colours.data(), renderer.cost.data(), width, height);
+        if (!writeImage(heat, colours.data(), width, height))
+        {
+            fprintf(stderr, "%s: cannot write, or not .png .ppm .pfm\n", heat);
+            return 1;
+        }
+    }
+    timelineStop();
+    if (timeline && !timelineWrite(timeline))
+    {
+        fprintf(stderr, "%s: cannot write\n", timeline);
+        return 1;
+    }
+
+    const RenderStats& s = renderer.stats;
+    if (fromCache)
+        printf("scene   %zu nodes, %zu lights from %s\n", renderer.scene->bvh.stats().nodes, renderer.scene->point_lights.size(), cachePath);
+    else
+        printf("scene   %zu objects, %zu lights\n", renderer.scene->objects.size(), renderer.scene->point_lights.size());
+    if (obj.bytes)
+        printf("load    %10.2f ms  OBJ %zu bytes at %.1f MB/s\n", loadMs, obj.bytes, obj.throughput());
+    else
+        printf("load    %10.2f ms\n", loadMs);
+    printf("init    %10.2f ms\n", initMs);
+    printf("render  %10.2f ms  %dx%d, %.2f Mpaths/s, depth %.3f\n", renderMs, width, height,
+        renderMs > 0 ? double(width) * height / (renderMs * 1000.0) : 0.0, s.averageDepth());
+    printf("write   %10.2f ms  %s\n", writeMs, out);
+    if (heat)
+        printf("heatmap %s, full scale %.0f %s a pixel\n", heat, scale, renderer.costMode == CostTests ? "tests" : "cycles");
+    if (timeline)
+        printf("timeline %s\n", timeline);
+    if (counters)
+    {
+        const TraversalStats& t = s.traversal;
+        printf("rays    %llu primary, %llu reflected, %llu shadow\n", s.paths, s.reflectionRays, s.shadowRays);
+        printf("shadow  %llu occluded, %llu by the last occluder of %llu tried\n", s.occluded, s.cacheHits, s.cacheTests);
+        printf("paths   %llu surfaces, %llu ended under the cutoff\n", s.hits, s.cutoffs);
+        printf("bvh     %llu nodes, %llu spheres, %llu polygons, %llu triangles, %llu objects tested\n", t.nodes,
+            t.tests[PrimSphere], t.tests[PrimPolygon], t.tests[PrimTriangle], t.tests[PrimObject]);
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////
+/// Scene generator: writes a seeded scene of one of the
+/// SceneSpec layouts as a scene description for rtr, and
+/// prints how fast it was generated.
+////////////////////////////////////////////////////////////
+#include "Trace.h"
+#include "SceneGen.h"
+#include "SceneFile.h"
+#include <stdio.h>              /* printf, fprintf */
+#include <stdlib.h>             /* strtoull */
+#include <string.h>             /* strcmp */
+#include <chrono>               /* steady_clock */
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: rtrgen [options] out.scene\n"
+        "  -l layout     field, grid, clusters or overlap (field)\n"
+        "  -n prims      objects, the floor included (1000)\n"
+        "  -L lights     lights on an array above the scene (2)\n"
+        "  -m materials  palette the objects pick from (16)\n"
+        "  -s seed       (1)\n");
+}
+
+int main(int argc, char** argv)
+{
+    SceneSpec spec;
+    const char* out = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* a = argv[i];
+        if (a[0] != '-')
+        {
+            out = a;
+            continue;
+        }
+        if (i + 1 == argc)
+        {
+            usage();
+            return 2;
+        }
+        const char* v = argv[++i];
+        if (!strcmp(a, "-l"))
+        {
+            if (!parseLayout(v, spec.layout))
+            {
+                usage();
+                return 2;
+            }
+        }
+        else if (!strcmp(a, "-n")) spec.prims = (size_t)strtoull(v, nullptr, 10);
+        else if (!strcmp(a, "-L")) spec.lights = (size_t)strtoull(v, nullptr, 10);
+        else if (!strcmp(a, "-m")) spec.materials = (size_t)strtoull(v, nullptr, 10);
+        else if (!strcmp(a, "-s")) spec.seed = strtoull(v, nullptr, 10);
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (!out)
+    {
+        usage();
+        return 2;
+    }
+
+    Renderer renderer;
+    auto started = std::chrono::steady_clock::now();
+    generateScene(renderer, spec);
+    const double generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    started = std::chrono::steady_clock::now();
+    if (!saveScene(renderer, out))
+    {
+        fprintf(stderr, "%s: cannot write\n", out);
+        return 1;
+    }
+    const double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    printf("scene     %s, %zu objects, %zu lights, seed %llu\n", layoutName(spec.layout),
+        renderer.scene->objects.size(), renderer.scene->point_lights.size(), spec.seed);
+    printf("generate  %10.2f ms  %.2f M objects/s\n", generateMs,
+        generateMs > 0 ? renderer.scene->objects.size() / (generateMs * 1e3) : 0.0);
+    printf("write     %10.2f ms  %s\n", writeMs, out);
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "SceneCache.h"         /* self definition */
+#include "Algebra.h"            /* Real */
+#include <string.h>             /* memcpy, memcmp */
+
+/* what leads every array: its length and element size */
+struct CacheArray
+{
+    unsigned long long count;
+    unsigned long long size;
+};
+
+CacheHeader::CacheHeader() :
+    version(SCENE_CACHE_VERSION), real(sizeof(Real)), order(0x01020304), reserved(0)
+{
+    memcpy(magic, "RTRSCENE", 8);
+}
+
+bool CacheHeader::compatible() const
+{
+    return !memcmp(magic, "RTRSCENE", 8) && version == SCENE_CACHE_VERSION &&
+        real == sizeof(Real) && order == 0x01020304;
+}
+
+CacheWriter::CacheWriter(FILE* _file) :
+    file(_file), offset(0), ok(_file != nullptr)
+{
+}
+
+void CacheWriter::pad()
+{
+    static const char zeros[CACHE_LINE] = { 0 };
+    const size_t n = size_t((CACHE_LINE - offset % CACHE_LINE) % CACHE_LINE);
+    if (ok && n && fwrite(zeros, 1, n, file) != n) ok = false;
+    offset += n;
+}
+
+void CacheWriter::array(const void* data, const size_t count, const size_t size)
+{
+    const CacheArray a = { count, size };
+    if (ok && fwrite(&a, sizeof(a), 1, file) != 1) ok = false;
+    offset += sizeof(a);
+    pad();
+    if (ok && count && fwrite(data, size, count, file) != count) ok = false;
+    offset += (unsigned long long)size * count;
+    pad();
+}
+
+CacheReader::CacheReader(const char* _data, const size_t _size) :
+    data(_data), size(_size), offset(0)
+{
+}
+
+////////////////////////////////////////////////////////////
+/// RETURNS: false when the next array is not made of
+///          elements of the given size or runs past the end
+///          of the file; true otherwise.
+////////////////////////////////////////////////////////////
+bool CacheReader::array(const void*& p, size_t& count, const size_t element)
+{
+    CacheArray a;
+    if (size - offset < sizeof(a)) return false;
+    memcpy(&a, data + offset, sizeof(a));
+    offset = (offset + sizeof(a) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (a.size != element || offset > size || a.count > (size - offset) / element) return false;
+    p = data + offset;
+    count = size_t(a.count);
+    offset = (offset + count * element + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (offset > size) offset = size;
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef _SCENECACHE_H_
+#define _SCENECACHE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <type_traits>          /* is_trivially_copyable */
+#include "Memory.h"
+
+#define SCENE_CACHE_VERSION 3   /* bumped whenever an array changes layout */
+
+////////////////////////////////////////////////////////////
+/// First array of a scene cache. Caches are only used by
+/// builds of the same version, scalar type and byte order.
+////////////////////////////////////////////////////////////
+struct CacheHeader
+{
+    char magic[8];              // "RTRSCENE"
+    unsigned int version;       // SCENE_CACHE_VERSION
+    unsigned int real;          // sizeof(Real)
+    unsigned int order;         // 0x01020304 as written
+    unsigned int reserved;
+    CacheHeader();
+    bool compatible() const;
+};
+
+////////////////////////////////////////////////////////////
+/// Writing a scene cache: arrays one after the other, each
+/// led by its length and element size and aligned to a
+/// cache line, so a reader can use them in place once the
+/// file is mapped.
+////////////////////////////////////////////////////////////
+class CacheWriter
+{
+public:
+    explicit CacheWriter(FILE* _file);
+    template <class T> void put(const T* data, const size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "cached arrays are copied byte for byte");
+        array(data, count, sizeof(T));
+    }
+    template <class T, class A> void put(const Storage<T, A>& s) { put(s.data(), s.size()); }
+    template <class T> void value(const T& v) { put(&v, 1); }
+    bool good() const { return ok; }
+private:
+    FILE* file;
+    unsigned long long offset;
+    bool ok;
+    void array(const void* data, const size_t count, const size_t size);
+    void pad();
+};
+
+////////////////////////////////////////////////////////////
+/// Reading the arrays of a mapped scene cache in the order
+/// they were written. Nothing is copied: arrays are handed
+/// out as pointers into the mapping, once their length and
+/// element size are checked against the file.
+////////////////////////////////////////////////////////////
+class CacheReader
+{
+public:
+    CacheReader(const char* _data, const size_t _size);
+    template <class T> bool get(const T*& data, size_t& count)
+    {
+        const void* p;
+        if (!array(p, count, sizeof(T))) return false;
+        data = static_cast<const T*>(p);
+        return true;
+    }
+    template <class T, class A> bool get(Storage<T, A>& s)
+    {
+        const T* d;
+        size_t n;
+        if (!get(d, n)) return false;
+        s.view(d, n);
+        return true;
+    }
+    template <class T> bool value(T& v)
+    {
+        const T* d;
+        size_t n;
+        if (!get(d, n) || n != 1) return false;
+        v = *d;
+        return true;
+    }
+private:
+    const char* data;
+    size_t size, offset;
+    bool array(const void*& p, size_t& count, const size_t element);
+};
+
+#endif
@@ -0,0 +1,366 @@
+#include "SceneFile.h"           /* self definition */
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "TextParse.h"
+#include "Timeline.h"
+#include "Trace.h"
+#include <stdio.h>              /* fopen, fprintf, snprintf */
+#include <string.h>             /* memcmp, strcmp, strstr, memmove */
+#include <locale.h>             /* localeconv */
+#include <unordered_map>
+
+////////////////////////////////////////////////////////////
+/// Where the tokenizer is in the file, and what went wrong
+/// when a statement cannot be parsed.
+////////////////////////////////////////////////////////////
+struct SceneParser
+{
+    const char *p, *end;        // p is inside the current line
+    size_t line;                // 1 based
+    std::string message;
+    bool fail(const char* what);
+    bool atEnd();               // nothing left on the line but spaces and a comment
+    bool word(const char*& token, size_t& length);
+    bool number(Real& value);
+    bool vector(Vec3r& value);
+};
+
+bool SceneParser::fail(const char* what)
+{
+    if (message.empty())
+        message = "line " + std::to_string(line) + ": " + what;
+    return false;
+}
+
+bool SceneParser::atEnd()
+{
+    p = skipSpaces(p, end);
+    return p >= end || isLineEnd(*p);
+}
+
+bool SceneParser::word(const char*& token, size_t& length)
+{
+    if (atEnd()) return false;
+    token = p;
+    p = tokenEnd(p, end);
+    length = p - token;
+    return true;
+}
+
+bool SceneParser::number(Real& value)
+{
+    double v;
+    const char* q = atEnd() ? nullptr : parseNumber(p, end, v);
+    if (!q || (q < end && !isSpace(*q) && !isLineEnd(*q))) return fail("number expected");
+    p = q;
+    value = Real(v);
+    return true;
+}
+
+bool SceneParser::vector(Vec3r& value)
+{
+    return number(value.x) && number(value.y) && number(value.z);
+}
+
+static inline bool is(const char* token, const size_t length, const char* name)
+{
+    return strlen(name) == length && !memcmp(token, name, length);
+}
+
+////////////////////////////////////////////////////////////
+/// Parsing the rest of a material statement, the name and
+/// the coefficients that are not zero.
+////////////////////////////////////////////////////////////
+static bool parseMaterial(SceneParser& in, std::unordered_map<std::string, Material>& materials)
+{
+    const char* token;
+    size_t length;
+    if (!in.word(token, length)) return in.fail("material name expected");
+    Material& m = materials[std::string(token, length)];
+    m.ambient = m.diffuse = Vec3r(0, 0, 0);
+    m.specular = m.exponent = m.reflect = 0;
+    while (in.word(token, length))
+    {
+        bool ok;
+        if (is(token, length, "ambient")) ok = in.vector(m.ambient);
+        else if (is(token, length, "diffuse")) ok = in.vector(m.diffuse);
+        else if (is(token, length, "specular")) ok = in.number(m.specular);
+        else if (is(token, length, "exponent")) ok = in.number(m.exponent);
+        else if (is(token, length, "reflect")) ok = in.number(m.reflect);
+        else return in.fail("unknown material coefficient");
+        if (!ok) return false;
+    }
+    return true;
+}
+
+/* kinds of object in the order loadScene keeps */
+#define OBJ_SPHERE 0
+#define OBJ_POLYGON 1
+#define OBJ_MESH 2
+
+/* directory of path, separator included, to resolve files named by the scene */
+static std::string directory(const char* path)
+{
+    const std::string p(path);
+    const size_t slash = p.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : p.substr(0, slash + 1);
+}
+
+////////////////////////////////////////////////////////////
+/// Walking the mapped file once, line by line, building
+/// each object as its statement is read, into one array
+/// per kind of object the scene keeps in its blocks rather
+/// than one allocation each. Spheres, the bulk of large
+/// scenes, look up the material only when it is another
+/// one than the sphere before them used.
+////////////////////////////////////////////////////////////
+bool loadScene(Renderer& renderer, const char* path, ThreadPool* pool, std::string* error, ObjStats* obj)
+{
+    const TimelineSpan span("load scene");
+    if (obj) *obj = ObjStats();
+    MappedFile file;
+    if (!file.open(path))
+    {
+        if (error) *error = std::string("cannot open ") + path;
+        return false;
+    }
+    std::shared_ptr<Scene> scene(new Scene());
+    std::vector<std::shared_ptr<Camera> > cameras;
+    std::unordered_map<std::string, Material> materials;
+    std::vector<Sphere> spheres;
+    std::vector<TPolygon> polygons;
+    std::vector<TriangleMesh> meshes;
+    std::vector<PointLight> lights;
+    std::vector<size_t> order;                  /* objects in file order: index * 4 + OBJ_SPHERE, OBJ_POLYGON or OBJ_MESH */
+    scene->ambient = Vec3r(0, 0, 0);
+
+    SceneParser in;
+    in.end = file.data() + file.size();
+    in.line = 0;
+    const char* lastName = nullptr;
+    size_t lastLength = 0;
+    const Material* last = nullptr;
+    const auto material = [&](const Material*& m)     /* m is nullptr unless found */
+    {
+        const char* token;
+        size_t length;
+        m = nullptr;
+        if (!in.word(token, length)) return in.fail("material name expected");
+        if (last && length == lastLength && !memcmp(token, lastName, length))
+        {
+            m = last;
+            return true;
+        }
+        const auto found = materials.find(std::string(token, length));
+        if (found == materials.end()) return in.fail("undefined material");
+        lastName = token;
+        lastLength = length;
+        m = last = &found->second;
+        return true;
+    };
+
+    bool ok = true;
+    for (const char* p = file.data(); ok && p < in.end; p = nextLine(p, in.end))
+    {
+        ++in.line;
+        in.p = p;
+        const char* token;
+        size_t length;
+        if (!in.word(token, length)) continue;                     /* blank or comment */
+        const Material* m = nullptr;
+        if (is(token, length, "sphere"))
+        {
+            spheres.emplace_back();
+            Sphere& s = spheres.back();
+            ok = material(m) && in.vector(s.centre) && in.number(s.radius);
+            if (ok && s.radius <= 0) ok = in.fail("radius must be positive");
+            if (!ok) break;
+            s.material = *m;
+            order.push_back((spheres.size() - 1) * 4 + OBJ_SPHERE);
+        }
+        else if (is(token, length, "polygon"))
+        {
+            polygons.emplace_back();
+            TPolygon& poly = polygons.back();
+            ok = material(m);
+            while (ok && !in.atEnd())
+            {
+                Vec3r v;
+                if ((ok = in.vector(v))) poly.vertices.push_back(v);
+            }
+            if (ok && poly.vertices.size() < 3) ok = in.fail("polygon needs three vertices");
+            if (!ok) break;
+            poly.vertices.push_back(poly.vertices.front());     /* closed, as edges are built */
+            poly.inormal = Vec3r(0, 0, 0);
+            poly.material = *m;
+            order.push_back((polygons.size() - 1) * 4 + OBJ_POLYGON);
+        }
+        else if (is(token, length, "mesh"))
+        {
+            if (!(ok = material(m))) break;
+            if (!in.word(token, length))
+            {
+                ok = in.fail("mesh file expected");
+                break;
+            }
+            std::string name(token, length);
+            if (name[0] != '/' && name[0] != '\\' && (name.size() < 2 || name[1] != ':'))
+                name = directory(path) + name;
+            meshes.emplace_back();
+            ObjStats one;
+            if (!loadObj(meshes.back(), name.c_str(), pool, &one))
+            {
+                ok = in.fail("cannot load mesh");
+                break;
+            }
+            if (obj)
+            {
+                obj->ms += one.ms;
+                obj->bytes += one.bytes;
+                obj->vertices += one.vertices;
+                obj->triangles += one.triangles;
+            }
+            meshes.back().material = *m;
+            order.push_back((meshes.size() - 1) * 4 + OBJ_MESH);
+        }
+        else if (is(token, length, "light"))
+        {
+            lights.emplace_back();
+            if (!(ok = in.vector(lights.back().centre) && in.vector(lights.back().intensity))) break;
+        }
+        else if (is(token, length, "material"))
+            ok = parseMaterial(in, materials);
+        else if (is(token, length, "ambient"))
+            ok = in.vector(scene->ambient);
+        else if (is(token, length, "camera"))
+        {
+            Vec3r viewer, screen, u, v;
+            if ((ok = in.vector(viewer) && in.vector(screen) && in.vector(u) && in.vector(v)))
+                cameras.push_back(std::shared_ptr<Camera>(new Camera(viewer, screen, u, v)));
+        }
+        else
+            ok = in.fail("unknown statement");
+        if (ok && !in.atEnd()) ok = in.fail("unexpected text after the statement");
+    }
+    if (!ok)
+    {
+        if (error) *error = std::string(path) + ": " + in.message;
+        return false;
+    }
+    const size_t lightCount = lights.size();
+    Sphere* const sphereBlock = scene->keep(spheres);
+    TPolygon* const polygonBlock = scene->keep(polygons);
+    TriangleMesh* const meshBlock = scene->keep(meshes);
+    PointLight* const lightBlock = scene->keep(lights);
+    scene->objects.reserve(order.size());
+    for (const size_t o : order)
+    {
+        const size_t i = o / 4;
+        scene->objects.push_back(o % 4 == OBJ_SPHERE ? static_cast<BaseObject*>(sphereBlock + i) :
+            o % 4 == OBJ_POLYGON ? static_cast<BaseObject*>(polygonBlock + i) : meshBlock + i);
+    }
+    for (size_t i = 0; i < lightCount; ++i)
+        scene->point_lights.push_back(lightBlock + i);
+    renderer.scene = scene;
+    renderer.cameras = cameras;
+    return true;
+}
+
+/* digits for a Real to read back to the same value */
+#define REAL_DIGITS (sizeof(Real) == sizeof(float) ? 9 : 17)
+
+/* a space and x, with '.' as the decimal point whatever the locale printf follows */
+static void writeNumber(FILE* file, const Real x)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%.*g", REAL_DIGITS, double(x));
+    const char* point = localeconv()->decimal_point;
+    const size_t length = strlen(point);
+    char* found = length && strcmp(point, ".") ? strstr(text, point) : nullptr;
+    if (found)
+    {
+        *found = '.';
+        memmove(found + 1, found + length, strlen(found + length) + 1);
+    }
+    fprintf(file, " %s", text);
+}
+
+static void writeVector(FILE* file, const Vec3r& v)
+{
+    writeNumber(file, v.x);
+    writeNumber(file, v.y);
+    writeNumber(file, v.z);
+}
+
+bool saveScene(const Renderer& renderer, const char* path)
+{
+    const Scene& scene = *renderer.scene;
+    std::unordered_map<std::string, size_t> names;              /* bytes of a material, its number */
+    std::vector<const Material*> materials;
+    std::vector<size_t> used(scene.objects.size());
+    for (size_t i = 0; i < scene.objects.size(); ++i)
+    {
+        const BaseObject* o = scene.objects[i];
+        if (!dynamic_cast<const Sphere*>(o) && !dynamic_cast<const TPolygon*>(o)) return false;
+        const std::string key((const char*)&o->material, sizeof(Material));
+        const auto found = names.emplace(key, materials.size());
+        if (found.second) materials.push_back(&o->material);
+        used[i] = found.first->second;
+    }
+
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    for (const std::shared_ptr<Camera>& c : renderer.cameras)
+    {
+        fprintf(file, "camera");
+        writeVector(file, c->viewer);
+        writeVector(file, c->screen);
+        writeVector(file, c->screenU);
+        writeVector(file, c->screenV);
+        fprintf(file, "\n");
+    }
+    fprintf(file, "ambient");
+    writeVector(file, scene.ambient);
+    fprintf(file, "\n");
+    for (const PointLight* l : scene.point_lights)
+    {
+        fprintf(file, "light");
+        writeVector(file, l->centre);
+        writeVector(file, l->intensity);
+        fprintf(file, "\n");
+    }
+    for (size_t i = 0; i < materials.size(); ++i)
+    {
+        const Material& m = *materials[i];
+        fprintf(file, "material m%zu ambient", i);
+        writeVector(file, m.ambient);
+        fprintf(file, " diffuse");
+        writeVector(file, m.diffuse);
+        fprintf(file, " specular");
+        writeNumber(file, m.specular);
+        fprintf(file, " exponent");
+        writeNumber(file, m.exponent);
+        fprintf(file, " reflect");
+        writeNumber(file, m.reflect);
+        fprintf(file, "\n");
+    }
+    for (size_t i = 0; i < scene.objects.size(); ++i)
+    {
+        const BaseObject* o = scene.objects[i];
+        if (const Sphere* s = dynamic_cast<const Sphere*>(o))
+        {
+            fprintf(file, "sphere m%zu", used[i]);
+            writeVector(file, s->centre);
+            writeNumber(file, s->radius);
+            fprintf(file, "\n");
+            continue;
+        }
+        const TPolygon* p = static_cast<const TPolygon*>(o);
+        fprintf(file, "polygon m%zu", used[i]);
+        for (size_t v = 0; v + 1 < p->vertices.size(); ++v)           /* the closing vertex is implied */
+            writeVector(file, p->vertices[v]);
+        fprintf(file, "\n");
+    }
+    const bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,47 @@
+#ifndef _SCENEFILE_H_
+#define _SCENEFILE_H_
+
+#include <string>
+
+class Renderer;
+class ThreadPool;
+struct ObjStats;
+
+////////////////////////////////////////////////////////////
+/// Loading a scene description into a renderer, replacing
+/// its scene and cameras. The file is text, one statement
+/// per line, '#' starting a comment:
+///
+///   camera   viewer(x y z) screen(x y z) u(x y z) v(x y z)
+///   ambient  r g b
+///   light    x y z  r g b
+///   material name [ambient r g b] [diffuse r g b]
+///            [specular s] [exponent e] [reflect k]
+///   sphere   material  x y z  radius
+///   polygon  material  x y z  x y z  x y z ...
+///   mesh     material  file.obj
+///
+/// Materials are defined before the objects using them;
+/// mesh paths are relative to the scene file. Meshes are
+/// parsed on the pool, when there is one, and their loads
+/// summed into obj when it is given.
+///
+/// RETURNS: true when loaded; false when the file cannot
+///          be mapped or a statement is malformed, with
+///          the line and what is wrong in error.
+////////////////////////////////////////////////////////////
+bool loadScene(Renderer& renderer, const char* path, ThreadPool* pool = nullptr, std::string* error = nullptr,
+    ObjStats* obj = nullptr);
+
+////////////////////////////////////////////////////////////
+/// Writing the scene and cameras of a renderer as a scene
+/// description loadScene reads back unchanged. Materials
+/// objects share are written once.
+///
+/// RETURNS: false when the file cannot be written or the
+///          scene holds meshes, which live in files of their
+///          own.
+////////////////////////////////////////////////////////////
+bool saveScene(const Renderer& renderer, const char* path);
+
+#endif
@@ -0,0 +1,141 @@
+#include "SceneGen.h"           /* self definition */
+#include "Trace.h"
+#include <string.h>             /* strcmp */
+#include <math.h>               /* sqrt, cbrt, log, cos, ceil */
+
+static const char* layoutNames[] = { "field", "grid", "clusters", "overlap" };
+
+SceneSpec::SceneSpec() :
+    layout(Field), prims(1000), lights(2), materials(16), seed(1)
+{
+}
+
+static TPolygon* tile(TPolygon& p, const Vec3r& centre, const Real half, const Real slope)
+{
+    const Real dx[] = { -half, half, half, -half }, dz[] = { half, half, -half, -half };
+    p.vertices.reserve(5);
+    for (int i = 0; i < 5; ++i)
+        p.vertices.push_back(centre + Vec3r(dx[i % 4], slope * dz[i % 4], dz[i % 4]));
+    p.inormal = Vec3r(0, 0, 0);
+    return &p;
+}
+
+void generateScene(Renderer& renderer, const SceneSpec& spec)
+{
+    SceneRandom rng(spec.seed);
+    std::shared_ptr<Scene> scene(new Scene());
+    scene->ambient = Vec3r(0.1, 0.1, 0.1);
+    renderer.cameras.clear();
+    renderer.cameras.push_back(std::shared_ptr<Camera>(new Camera(Vec3r(0, 0, 500), Vec3r(0, 0, 0), Vec3r(1, 0, 0), Vec3r(0, 1, 0))));
+
+    const size_t materials = spec.materials ? spec.materials : 1;
+    std::vector<Material> palette(materials);
+    for (Material& m : palette)
+    {
+        m.ambient = m.diffuse = rng.box(Vec3r(0.2, 0.2, 0.2), Vec3r(1, 1, 1));
+        m.specular = rng.uniform(0.3, 1);
+        m.exponent = Real(int(rng.uniform(10, 40)));
+        m.reflect = rng.uniform(0.1, 0.5);
+    }
+
+    /* lights on a square array above the scene */
+    const size_t side = (size_t)ceil(sqrt(double(spec.lights)));
+    PointLight* lights = spec.lights ? scene->block<PointLight>(spec.lights) : nullptr;
+    for (size_t i = 0; i < spec.lights; ++i)
+    {
+        lights[i].centre = Vec3r(Real(-400 + 800 * (i % side + 0.5) / side), -400, Real(-400 + 800 * (i / side + 0.5) / side));
+        lights[i].intensity = Vec3r(1, 1, 1) * Real(1.0 / spec.lights);
+        scene->point_lights.push_back(lights + i);
+    }
+
+    std::vector<BaseObject*>& objects = scene->objects;
+    objects.reserve(spec.prims);
+    if (!spec.prims)
+    {
+        renderer.scene = scene;
+        return;
+    }
+    if (spec.layout == SceneSpec::Grid)
+    {
+        const size_t cells = (size_t)ceil(sqrt(double(spec.prims)));
+        const Real cell = Real(800.0 / cells);
+        TPolygon* tiles = scene->block<TPolygon>(spec.prims);
+        for (size_t i = 0; i < spec.prims; ++i)
+        {
+            const Vec3r centre(-400 + cell * (i % cells + Real(0.5)), 130 - rng.uniform(0, 60), -400 + cell * (i / cells + Real(0.5)));
+            const Real slope = rng.uniform(-0.3, 0.3);
+            tile(tiles[i], centre, cell * Real(0.45), slope)->material = palette[rng.next() % materials];
+            objects.push_back(tiles + i);
+        }
+        renderer.scene = scene;
+        return;
+    }
+
+    TPolygon* floor = tile(*scene->block<TPolygon>(1), Vec3r(0, 130, 0), 400, 0);
+    floor->material.ambient = floor->material.diffuse = Vec3r(0.6, 0.6, 0.6);
+    floor->material.specular = 0.9;
+    floor->material.exponent = 30;
+    floor->material.reflect = 0.3;
+    objects.push_back(floor);
+
+    const size_t count = spec.prims - 1;
+    Sphere* spheres = count ? scene->block<Sphere>(count) : nullptr;
+    const double n = double(count ? count : 1);
+    switch (spec.layout)
+    {
+    case SceneSpec::Clusters:
+    {
+        const size_t clusters = (size_t)cbrt(n);
+        std::vector<Vec3r> centres(clusters);
+        for (Vec3r& c : centres)
+            c = rng.box(Vec3r(-250, -120, -250), Vec3r(250, 80, 250));
+        const double radius = 15 / cbrt(n / clusters);  /* about half the spacing within a clump */
+        for (size_t i = 0; i < count; ++i)
+        {
+            Sphere& s = spheres[i];
+            s.centre = centres[i % clusters] + rng.normal3(15);
+            s.radius = rng.uniform(0.5 * radius, 1.5 * radius);
+        }
+        break;
+    }
+    case SceneSpec::Overlap:
+        for (size_t i = 0; i < count; ++i)
+        {
+            spheres[i].centre = rng.box(Vec3r(-20, -40, -20), Vec3r(20, 0, 20));
+            spheres[i].radius = rng.uniform(40, 60);
+        }
+        break;
+    default:
+    {
+        const double radius = 60 / cbrt(n);
+        for (size_t i = 0; i < count; ++i)
+        {
+            spheres[i].centre = rng.box(Vec3r(-300, -170, -300), Vec3r(300, Real(130 - radius), 300));
+            spheres[i].radius = rng.uniform(0.5 * radius, 1.5 * radius);
+        }
+        break;
+    }
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        spheres[i].material = palette[rng.next() % materials];
+        objects.push_back(spheres + i);
+    }
+    renderer.scene = scene;
+}
+
+const char* layoutName(const SceneSpec::Layout layout)
+{
+    return layoutNames[layout];
+}
+
+bool parseLayout(const char* name, SceneSpec::Layout& layout)
+{
+    for (int i = SceneSpec::Field; i <= SceneSpec::Overlap; ++i)
+        if (!strcmp(name, layoutNames[i]))
+        {
+            layout = SceneSpec::Layout(i);
+            return true;
+        }
+    return false;
+}
@@ -0,0 +1,84 @@
+#ifndef _SCENEGEN_H_
+#define _SCENEGEN_H_
+
+#include <stddef.h>
+#include <math.h>               /* sqrt, log, cos */
+#include "Algebra.h"
+
+class Renderer;
+
+////////////////////////////////////////////////////////////
+/// SplitMix64: small, fast, and unlike the distributions
+/// of <random> it gives the same numbers everywhere, so
+/// generated scenes and the benches' inputs only depend
+/// on their seed.
+////////////////////////////////////////////////////////////
+class SceneRandom
+{
+public:
+    explicit SceneRandom(const unsigned long long seed) : state(seed) {}
+    unsigned long long next()
+    {
+        unsigned long long z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    Real uniform(const double a, const double b)
+    {
+        return Real(a + (b - a) * ((next() >> 11) * (1.0 / 9007199254740992.0)));
+    }
+    Vec3r box(const Vec3r& low, const Vec3r& high)  /* drawn x, y then z, whatever the compiler's order */
+    {
+        const Real x = uniform(low.x, high.x), y = uniform(low.y, high.y);
+        return Vec3r(x, y, uniform(low.z, high.z));
+    }
+    Vec3r normal3(const double sigma)
+    {
+        const Real x = normal(sigma), y = normal(sigma);
+        return Vec3r(x, y, normal(sigma));
+    }
+    Real normal(const double sigma)                 /* Box-Muller, one of the pair */
+    {
+        const double u = ((next() >> 11) + 1) * (1.0 / 9007199254740993.0), v = (next() >> 11) * (1.0 / 9007199254740992.0);
+        return Real(sigma * sqrt(-2 * log(u)) * cos(6.283185307179586 * v));
+    }
+private:
+    unsigned long long state;
+};
+
+////////////////////////////////////////////////////////////
+/// What to generate. Every layout is seen by the camera of
+/// the preset scene and lit by an array of lights above
+/// it, sharing an intensity of 1.
+////////////////////////////////////////////////////////////
+struct SceneSpec
+{
+    enum Layout
+    {
+        Field,                  // spheres spread evenly over a floor, shrinking as there are more
+        Grid,                   // tilted square tiles at random heights, no spheres
+        Clusters,               // dense gaussian clumps of small spheres over a floor
+        Overlap                 // large spheres around one point, all overlapping: the BVH worst case
+    };
+    Layout layout;
+    size_t prims;               // objects, a floor included
+    size_t lights;
+    size_t materials;           // palette objects pick from
+    unsigned long long seed;
+    SceneSpec();
+};
+
+////////////////////////////////////////////////////////////
+/// Generating a scene into a renderer, replacing its scene
+/// and cameras. Objects and lights are created in a few
+/// arrays the scene keeps in blocks, not one by one.
+/// Numbers come from a generator of its own, so a seed
+/// gives the same scene whichever standard library is used.
+////////////////////////////////////////////////////////////
+void generateScene(Renderer& renderer, const SceneSpec& spec);
+
+const char* layoutName(const SceneSpec::Layout layout);
+bool parseLayout(const char* name, SceneSpec::Layout& layout);     // false for an unknown name
+
+#endif
@@ -0,0 +1,79 @@
+#include "Simd.h"               /* self definition */
+#ifdef SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>             /* __cpuidex, _xgetbv */
+#else
+#include <cpuid.h>              /* __cpuid_count */
+#endif
+#endif
+
+#ifdef SIMD_X86
+static void cpuid(unsigned int regs[4], const unsigned int leaf, const unsigned int sub)
+{
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, int(leaf), int(sub));
+    for (int i = 0; i < 4; ++i) regs[i] = (unsigned int)r[i];
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+////////////////////////////////////////////////////////////
+/// Register state the OS saves on context switches; wide
+/// registers are useless unless it saves them.
+////////////////////////////////////////////////////////////
+static unsigned long long xgetbv()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+////////////////////////////////////////////////////////////
+/// Asking CPUID which kernels can run. Computed once.
+///
+/// RETURNS: The widest usable instruction set.
+////////////////////////////////////////////////////////////
+SimdLevel simdDetect()
+{
+    static const SimdLevel level = []()
+    {
+        SimdLevel best = SimdScalar;
+#ifdef SIMD_X86
+        unsigned int r[4];
+        cpuid(r, 0, 0);
+        const unsigned int leaves = r[0];
+        cpuid(r, 1, 0);
+        if (r[3] & (1u << 26)) best = SimdSSE2;
+        const bool avx = (r[2] & (1u << 27)) && (r[2] & (1u << 28));   /* OSXSAVE and AVX */
+        if (avx && leaves >= 7)
+        {
+            const unsigned long long xcr0 = xgetbv();
+            cpuid(r, 7, 0);
+            if ((xcr0 & 0x6) == 0x6 && (r[1] & (1u << 5))) best = SimdAVX2;
+#ifdef SIMD_AVX512
+            if ((xcr0 & 0xE6) == 0xE6 && (r[1] & (1u << 16))) best = SimdAVX512;
+#endif
+        }
+#endif
+        return best;
+    }();
+    return level;
+}
+
+const char* simdName(const SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdSSE2: return "sse2";
+    case SimdAVX2: return "avx2";
+    case SimdAVX512: return "avx512";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#if !defined(_MSC_VER) || _MSC_VER >= 1911      /* AVX-512 intrinsics came with VS 2017 15.3 */
+#define SIMD_AVX512
+#endif
+#endif
+
+////////////////////////////////////////////////////////////
+/// Instruction sets the kernels come in, from the slowest.
+////////////////////////////////////////////////////////////
+enum SimdLevel
+{
+    SimdScalar,
+    SimdSSE2,
+    SimdAVX2,
+    SimdAVX512
+};
+
+SimdLevel simdDetect();         // best level both the CPU and the OS support
+const char* simdName(const SimdLevel level);
+
+#endif
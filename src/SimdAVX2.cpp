@@ -0,0 +1,61 @@
+#include "Spheres.h"            /* sphere kernel declarations */
+#include "BVH.h"                /* box kernel declarations */
+
+#ifdef SIMD_X86
+/* only the kernels below are built for AVX2, with contraction into fused multiply-add off */
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#pragma GCC optimize("fp-contract=off")
+#endif
+#include <immintrin.h>          /* AVX2 */
+
+#define KERNEL_CLOSEST sphereClosestAVX2
+#define KERNEL_ANY sphereAnyAVX2
+#define KERNEL_PACKET spherePacketAVX2
+#define KERNEL_BOXES boxPacketAVX2
+#ifdef RTR_SINGLE_PRECISION
+#define LANES 8
+#define VEC __m256
+#define SET1 _mm256_set1_ps
+#define LOAD _mm256_loadu_ps
+#define STORE _mm256_storeu_ps
+#define ADD _mm256_add_ps
+#define SUB _mm256_sub_ps
+#define MUL _mm256_mul_ps
+#define DIV _mm256_div_ps
+#define SQRT _mm256_sqrt_ps
+#define MIN _mm256_min_ps
+#define MAX _mm256_max_ps
+#define GE(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ))
+#define GT(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))
+#define LT(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))
+#define LE(a, b) _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ))
+#else
+#define LANES 4
+#define VEC __m256d
+#define SET1 _mm256_set1_pd
+#define LOAD _mm256_loadu_pd
+#define STORE _mm256_storeu_pd
+#define ADD _mm256_add_pd
+#define SUB _mm256_sub_pd
+#define MUL _mm256_mul_pd
+#define DIV _mm256_div_pd
+#define SQRT _mm256_sqrt_pd
+#define MIN _mm256_min_pd
+#define MAX _mm256_max_pd
+#define GE(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ))
+#define GT(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ))
+#define LT(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ))
+#define LE(a, b) _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ))
+#endif
+#include "SimdKernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
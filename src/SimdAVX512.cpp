@@ -0,0 +1,64 @@
+#include "Spheres.h"            /* sphere kernel declarations */
+#include "BVH.h"                /* box kernel declarations */
+
+#ifdef SIMD_AVX512
+/* only the kernels below are built for AVX-512, with contraction into fused multiply-add off */
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"  /* _mm512_undefined_pd in GCC 12 headers */
+#endif
+#include <immintrin.h>          /* AVX-512F */
+
+#define KERNEL_CLOSEST sphereClosestAVX512
+#define KERNEL_ANY sphereAnyAVX512
+#define KERNEL_PACKET spherePacketAVX512
+#define KERNEL_BOXES boxPacketAVX512
+#ifdef RTR_SINGLE_PRECISION
+#define LANES 16
+#define VEC __m512
+#define SET1 _mm512_set1_ps
+#define LOAD _mm512_loadu_ps
+#define STORE _mm512_storeu_ps
+#define ADD _mm512_add_ps
+#define SUB _mm512_sub_ps
+#define MUL _mm512_mul_ps
+#define DIV _mm512_div_ps
+#define SQRT _mm512_sqrt_ps
+#define MIN _mm512_min_ps
+#define MAX _mm512_max_ps
+#define GE(a, b) int(_mm512_cmp_ps_mask(a, b, _CMP_GE_OQ))
+#define GT(a, b) int(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ))
+#define LT(a, b) int(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ))
+#define LE(a, b) int(_mm512_cmp_ps_mask(a, b, _CMP_LE_OQ))
+#else
+#define LANES 8
+#define VEC __m512d
+#define SET1 _mm512_set1_pd
+#define LOAD _mm512_loadu_pd
+#define STORE _mm512_storeu_pd
+#define ADD _mm512_add_pd
+#define SUB _mm512_sub_pd
+#define MUL _mm512_mul_pd
+#define DIV _mm512_div_pd
+#define SQRT _mm512_sqrt_pd
+#define MIN _mm512_min_pd
+#define MAX _mm512_max_pd
+#define GE(a, b) int(_mm512_cmp_pd_mask(a, b, _CMP_GE_OQ))
+#define GT(a, b) int(_mm512_cmp_pd_mask(a, b, _CMP_GT_OQ))
+#define LT(a, b) int(_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ))
+#define LE(a, b) int(_mm512_cmp_pd_mask(a, b, _CMP_LE_OQ))
+#endif
+#include "SimdKernels.inl"
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+#endif
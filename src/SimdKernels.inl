@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////
+/// Body of the SIMD kernels, included by one file per
+/// instruction set after it defines:
+///   KERNEL_CLOSEST, KERNEL_ANY, KERNEL_PACKET, KERNEL_BOXES
+///                               kernel names
+///   LANES, VEC                  Reals per register, its type
+///   SET1, LOAD, STORE           broadcast, unaligned load/store
+///   ADD, SUB, MUL, DIV, SQRT    lane wise arithmetic
+///   MIN, MAX                    (a < b ? a : b), (a > b ? a : b)
+///   GE, GT, LT, LE              comparisons, as a lane bit mask
+/// Operations are issued in the order of the scalar code
+/// and never fused, so every lane gives the scalar result.
+////////////////////////////////////////////////////////////
+
+#define SPHERE_LANE(i)                                                  \
+    const VEC ox = SUB(sx, LOAD(s.x + i)),                              \
+        oy = SUB(sy, LOAD(s.y + i)),                                    \
+        oz = SUB(sz, LOAD(s.z + i));                                    \
+    const VEC b = ADD(ADD(MUL(dx, ox), MUL(dy, oy)), MUL(dz, oz)),     \
+        c = SUB(ADD(ADD(MUL(ox, ox), MUL(oy, oy)), MUL(oz, oz)), LOAD(s.r2 + i)), \
+        det = SUB(MUL(b, b), c),                                        \
+        d = SUB(SUB(zero, b), SQRT(det));
+
+#define SPHERE_SETUP                                                    \
+    const VEC sx = SET1(q.sx), sy = SET1(q.sy), sz = SET1(q.sz),        \
+        dx = SET1(q.dx), dy = SET1(q.dy), dz = SET1(q.dz),              \
+        tmin = SET1(q.tmin), zero = SET1(0.0);
+
+size_t KERNEL_CLOSEST(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real& t)
+{
+    SPHERE_SETUP
+    alignas(64) Real lanes[LANES];
+    size_t hit = SphereSoA::none;
+    for (size_t i = first; i < first + count; i += LANES)
+    {
+        SPHERE_LANE(i)
+        int mask = GE(det, zero) & GT(d, tmin) & LT(d, SET1(t));
+        if (first + count - i < LANES)                  /* lanes past the run */
+            mask &= (1 << (first + count - i)) - 1;
+        if (mask)
+        {
+            STORE(lanes, d);
+            for (int l = 0; l < LANES; ++l)             /* in slot order, as a scalar loop */
+                if (((mask >> l) & 1) && lanes[l] < t && i + l != skip)
+                {
+                    t = lanes[l];
+                    hit = i + l;
+                }
+        }
+    }
+    return hit;
+}
+
+size_t KERNEL_ANY(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real tmax)
+{
+    SPHERE_SETUP
+    const VEC limit = SET1(tmax);
+    for (size_t i = first; i < first + count; i += LANES)
+    {
+        SPHERE_LANE(i)
+        int mask = GE(det, zero) & GT(d, tmin) & LE(d, limit);
+        if (first + count - i < LANES)
+            mask &= (1 << (first + count - i)) - 1;
+        for (int l = 0; mask; ++l, mask >>= 1)
+            if ((mask & 1) && i + l != skip) return i + l;
+    }
+    return SphereSoA::none;
+}
+
+////////////////////////////////////////////////////////////
+/// Packets put rays in the lanes instead of spheres; the
+/// parts of the test that only depend on the sphere are
+/// computed once and broadcast.
+////////////////////////////////////////////////////////////
+void KERNEL_PACKET(const SphereArrays& s, const SpherePacket& p, size_t first, size_t count)
+{
+    const VEC zero = SET1(0.0);
+    alignas(64) Real lanes[LANES];
+    for (size_t i = first; i < first + count; ++i)
+    {
+        const Real ox = p.sx - s.x[i], oy = p.sy - s.y[i], oz = p.sz - s.z[i];
+        const VEC vx = SET1(ox), vy = SET1(oy), vz = SET1(oz),
+            c = SET1((ox * ox + oy * oy + oz * oz) - s.r2[i]);
+        for (size_t l = 0; l < p.lanes; l += LANES)
+        {
+            const VEC b = ADD(ADD(MUL(LOAD(p.dx + l), vx), MUL(LOAD(p.dy + l), vy)), MUL(LOAD(p.dz + l), vz)),
+                det = SUB(MUL(b, b), c),
+                d = SUB(SUB(zero, b), SQRT(det));
+            int mask = GE(det, zero) & GT(d, zero) & LT(d, LOAD(p.t + l));
+            if (mask)
+            {
+                STORE(lanes, d);
+                for (int k = 0; mask; ++k, mask >>= 1)
+                    if (mask & 1)
+                    {
+                        p.t[l + k] = lanes[k];
+                        p.hit[l + k] = i;
+                    }
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Slab test of every lane of a packet against one box,
+/// the branches of the scalar test turned into MIN / MAX.
+////////////////////////////////////////////////////////////
+unsigned long long KERNEL_BOXES(const BoxPacket& p, const Real* lo, const Real* hi)
+{
+    const VEC x0 = SET1(lo[0]), y0 = SET1(lo[1]), z0 = SET1(lo[2]),
+        x1 = SET1(hi[0]), y1 = SET1(hi[1]), z1 = SET1(hi[2]), zero = SET1(0.0);
+    unsigned long long mask = 0;
+    for (size_t l = 0; l < p.lanes; l += LANES)
+    {
+        VEC near = zero, far = LOAD(p.t + l), t0, t1;
+        t0 = MUL(x0, LOAD(p.ix + l)); t1 = MUL(x1, LOAD(p.ix + l));
+        near = MAX(MIN(t1, t0), near); far = MIN(MAX(t0, t1), far);
+        t0 = MUL(y0, LOAD(p.iy + l)); t1 = MUL(y1, LOAD(p.iy + l));
+        near = MAX(MIN(t1, t0), near); far = MIN(MAX(t0, t1), far);
+        t0 = MUL(z0, LOAD(p.iz + l)); t1 = MUL(z1, LOAD(p.iz + l));
+        near = MAX(MIN(t1, t0), near); far = MIN(MAX(t0, t1), far);
+        mask |= (unsigned long long)LE(near, far) << l;
+    }
+    return mask;
+}
+
+#undef SPHERE_LANE
+#undef SPHERE_SETUP
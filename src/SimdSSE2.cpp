@@ -0,0 +1,48 @@
+#include "Spheres.h"            /* sphere kernel declarations */
+#include "BVH.h"                /* box kernel declarations */
+
+#ifdef SIMD_X86
+#include <emmintrin.h>          /* SSE2, part of every x86-64 */
+
+#define KERNEL_CLOSEST sphereClosestSSE2
+#define KERNEL_ANY sphereAnySSE2
+#define KERNEL_PACKET spherePacketSSE2
+#define KERNEL_BOXES boxPacketSSE2
+#ifdef RTR_SINGLE_PRECISION
+#define LANES 4
+#define VEC __m128
+#define SET1 _mm_set1_ps
+#define LOAD _mm_loadu_ps
+#define STORE _mm_storeu_ps
+#define ADD _mm_add_ps
+#define SUB _mm_sub_ps
+#define MUL _mm_mul_ps
+#define DIV _mm_div_ps
+#define SQRT _mm_sqrt_ps
+#define MIN _mm_min_ps
+#define MAX _mm_max_ps
+#define GE(a, b) _mm_movemask_ps(_mm_cmpge_ps(a, b))
+#define GT(a, b) _mm_movemask_ps(_mm_cmpgt_ps(a, b))
+#define LT(a, b) _mm_movemask_ps(_mm_cmplt_ps(a, b))
+#define LE(a, b) _mm_movemask_ps(_mm_cmple_ps(a, b))
+#else
+#define LANES 2
+#define VEC __m128d
+#define SET1 _mm_set1_pd
+#define LOAD _mm_loadu_pd
+#define STORE _mm_storeu_pd
+#define ADD _mm_add_pd
+#define SUB _mm_sub_pd
+#define MUL _mm_mul_pd
+#define DIV _mm_div_pd
+#define SQRT _mm_sqrt_pd
+#define MIN _mm_min_pd
+#define MAX _mm_max_pd
+#define GE(a, b) _mm_movemask_pd(_mm_cmpge_pd(a, b))
+#define GT(a, b) _mm_movemask_pd(_mm_cmpgt_pd(a, b))
+#define LT(a, b) _mm_movemask_pd(_mm_cmplt_pd(a, b))
+#define LE(a, b) _mm_movemask_pd(_mm_cmple_pd(a, b))
+#endif
+#include "SimdKernels.inl"
+
+#endif
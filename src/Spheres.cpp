@@ -0,0 +1,233 @@
+#include "Spheres.h"            /* self definition */
+#include "SceneCache.h"
+#include <math.h>               /* sqrt, fabs */
+
+SphereQuery::SphereQuery(const Ray& r) :
+    sx(r.start.x), sy(r.start.y), sz(r.start.z), dx(r.direction.x), dy(r.direction.y), dz(r.direction.z), tmin(r.tmin)
+{
+}
+
+SphereSoA::SphereSoA()
+{
+    resize(0);
+    select(simdDetect());
+}
+
+SphereSoA::SphereSoA(const SphereSoA& s) :
+    cx(s.cx), cy(s.cy), cz(s.cz), r2(s.r2), ir(s.ir),
+    simd(s.simd), closestFn(s.closestFn), anyFn(s.anyFn), packetFn(s.packetFn)
+{
+    bind();
+}
+
+SphereSoA& SphereSoA::operator = (const SphereSoA& s)
+{
+    cx = s.cx;
+    cy = s.cy;
+    cz = s.cz;
+    r2 = s.r2;
+    ir = s.ir;
+    simd = s.simd;
+    closestFn = s.closestFn;
+    anyFn = s.anyFn;
+    packetFn = s.packetFn;
+    bind();
+    return *this;
+}
+
+/* pointing the kernels at the arrays, owned or viewed in a cache */
+void SphereSoA::bind()
+{
+    arrays.x = cx.data();
+    arrays.y = cy.data();
+    arrays.z = cz.data();
+    arrays.r2 = r2.data();
+}
+
+////////////////////////////////////////////////////////////
+/// Sizing the arrays for size spheres, plus the padding the
+/// widest kernel may read past the last run.
+////////////////////////////////////////////////////////////
+void SphereSoA::resize(const size_t size)
+{
+    const size_t padded = (size + 2 * SPHERE_LANES - 1) / SPHERE_LANES * SPHERE_LANES;
+    cx.assign(padded, 0.0);
+    cy.assign(padded, 0.0);
+    cz.assign(padded, 0.0);
+    r2.assign(padded, 0.0);
+    ir.assign(size, 0.0);
+    bind();
+}
+
+void SphereSoA::save(CacheWriter& out) const
+{
+    out.put(cx);
+    out.put(cy);
+    out.put(cz);
+    out.put(r2);
+    out.put(ir);
+}
+
+////////////////////////////////////////////////////////////
+/// Viewing the arrays of a cache in place, for size spheres.
+///
+/// RETURNS: false when they are missing or too short for
+///          the kernels to read their padding.
+////////////////////////////////////////////////////////////
+bool SphereSoA::attach(CacheReader& in, const size_t size)
+{
+    const size_t padded = (size + 2 * SPHERE_LANES - 1) / SPHERE_LANES * SPHERE_LANES;
+    if (!in.get(cx) || !in.get(cy) || !in.get(cz) || !in.get(r2) || !in.get(ir))
+        return false;
+    if (cx.size() < padded || cy.size() < padded || cz.size() < padded || r2.size() < padded || ir.size() < size)
+        return false;
+    bind();
+    return true;
+}
+
+void SphereSoA::set(const size_t i, const Vec3r& centre, const Real radius)
+{
+    cx[i] = centre.x;
+    cy[i] = centre.y;
+    cz[i] = centre.z;
+    r2[i] = radius * radius;
+    ir[i] = 1 / fabs(radius);
+}
+
+void SphereSoA::select(const SimdLevel level)
+{
+    simd = level < simdDetect() ? level : simdDetect();
+    closestFn = sphereClosestScalar;
+    anyFn = sphereAnyScalar;
+    packetFn = spherePacketScalar;
+    switch (simd)
+    {
+#ifdef SIMD_AVX512
+    case SimdAVX512:
+        closestFn = sphereClosestAVX512;
+        anyFn = sphereAnyAVX512;
+        packetFn = spherePacketAVX512;
+        break;
+#endif
+#ifdef SIMD_X86
+    case SimdAVX2:
+        closestFn = sphereClosestAVX2;
+        anyFn = sphereAnyAVX2;
+        packetFn = spherePacketAVX2;
+        break;
+    case SimdSSE2:
+        closestFn = sphereClosestSSE2;
+        anyFn = sphereAnySSE2;
+        packetFn = spherePacketSSE2;
+        break;
+#endif
+    default:
+        simd = SimdScalar;
+        break;
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Finding the closest of spheres [first, first+count)
+/// hit within (tmin, t).
+///
+/// RETURNS: Its index, none if there is none; t is set to
+///          its distance.
+////////////////////////////////////////////////////////////
+size_t SphereSoA::closest(const SphereQuery& q, const size_t skip,
+    const size_t first, const size_t count, Real& t) const
+{
+    return closestFn(arrays, q, skip, first, count, t);
+}
+
+////////////////////////////////////////////////////////////
+/// RETURNS: The index of the first sphere of the run found
+///          hit within (tmin, tmax], none if there is none.
+////////////////////////////////////////////////////////////
+size_t SphereSoA::any(const SphereQuery& q, const size_t skip,
+    const size_t first, const size_t count, const Real tmax) const
+{
+    return anyFn(arrays, q, skip, first, count, tmax);
+}
+
+////////////////////////////////////////////////////////////
+/// Testing every lane of a packet against the spheres
+/// [first, first+count), lowering t and setting hit of the
+/// lanes that meet one closer.
+////////////////////////////////////////////////////////////
+void SphereSoA::packet(const SpherePacket& p, const size_t first, const size_t count) const
+{
+    packetFn(arrays, p, first, count);
+}
+
+////////////////////////////////////////////////////////////
+/// Scalar kernels, the same arithmetic as Sphere::intersect.
+////////////////////////////////////////////////////////////
+static inline Real sphereHit(const SphereArrays& s, const SphereQuery& q, const size_t i)
+{
+    const Real ox = q.sx - s.x[i], oy = q.sy - s.y[i], oz = q.sz - s.z[i];
+    const Real b = q.dx * ox + q.dy * oy + q.dz * oz,
+        c = (ox * ox + oy * oy + oz * oz) - s.r2[i],
+        det = b * b - c;
+    if (det < 0.0 || -b <= q.tmin) return -1.0;             /* missed, or both roots behind tmin */
+    return -b - sqrt(det);
+}
+
+////////////////////////////////////////////////////////////
+/// Finding intersection of a ray with sphere i,
+/// as Sphere::intersect does.
+///
+/// RETURNS: Distance from the origine of the ray, -1 when
+///          it is not within (tmin, tmax).
+////////////////////////////////////////////////////////////
+Real SphereSoA::intersect(const size_t i, const Ray& r) const
+{
+    const Real d = sphereHit(arrays, SphereQuery(r), i);
+    return r.within(d) ? d : -1.0;
+}
+
+size_t sphereClosestScalar(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real& t)
+{
+    size_t hit = SphereSoA::none;
+    for (size_t i = first; i < first + count; ++i)
+    {
+        const Real d = sphereHit(s, q, i);
+        if ((d > q.tmin) && (d < t) && i != skip)
+        {
+            t = d;
+            hit = i;
+        }
+    }
+    return hit;
+}
+
+size_t sphereAnyScalar(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real tmax)
+{
+    for (size_t i = first; i < first + count; ++i)
+    {
+        const Real d = sphereHit(s, q, i);
+        if ((d > q.tmin) && (d <= tmax) && i != skip) return i;
+    }
+    return SphereSoA::none;
+}
+
+void spherePacketScalar(const SphereArrays& s, const SpherePacket& p, size_t first, size_t count)
+{
+    for (size_t i = first; i < first + count; ++i)
+    {
+        const Real ox = p.sx - s.x[i], oy = p.sy - s.y[i], oz = p.sz - s.z[i],
+            c = (ox * ox + oy * oy + oz * oz) - s.r2[i];    /* the same for every lane */
+        for (size_t l = 0; l < p.lanes; ++l)
+        {
+            const Real b = p.dx[l] * ox + p.dy[l] * oy + p.dz[l] * oz,
+                det = b * b - c;
+            if (det < 0.0) continue;
+            const Real d = -b - sqrt(det);
+            if ((d > 0) && (d < p.t[l]))
+            {
+                p.t[l] = d;
+                p.hit[l] = i;
+            }
+        }
+    }
+}
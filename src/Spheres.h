@@ -0,0 +1,112 @@
+#ifndef _SPHERES_H_
+#define _SPHERES_H_
+
+#include <vector>
+#include "Algebra.h"
+#include "Ray.h"
+#include "Memory.h"
+#include "Simd.h"
+
+class CacheWriter;
+class CacheReader;
+
+#define SPHERE_LANES (CACHE_LINE / sizeof(Real))    /* lanes of the widest kernel; arrays are padded to it */
+
+////////////////////////////////////////////////////////////
+/// Constants of one ray shared by all sphere kernels. With
+/// a unit direction the quadratic of Sphere::intersect
+/// reduces to t = -b - sqrt(b * b - c), which the kernels
+/// repeat bit for bit.
+////////////////////////////////////////////////////////////
+struct SphereQuery
+{
+    Real sx, sy, sz;            // origin of the ray
+    Real dx, dy, dz;            // its unit direction
+    Real tmin;                  // nearest distance a hit counts at
+    explicit SphereQuery(const Ray& r);
+};
+
+struct SphereArrays
+{
+    const Real *x, *y, *z, *r2;
+};
+
+////////////////////////////////////////////////////////////
+/// Lanes of rays sharing their origin, tested together
+/// against one sphere at a time. Lanes are a multiple of
+/// SPHERE_LANES; t is the limit of each lane and a lane
+/// with t = 0 never hits.
+////////////////////////////////////////////////////////////
+struct SpherePacket
+{
+    size_t lanes;
+    Real sx, sy, sz;            // shared origin
+    const Real *dx, *dy, *dz;   // unit directions
+    Real* t;                    // closest hit so far, per lane
+    size_t* hit;                // its sphere, per lane
+};
+
+////////////////////////////////////////////////////////////
+/// Spheres kept as structure of arrays: centres and squared
+/// radii, each array 64 byte aligned, so one kernel call
+/// tests a whole run of them with SIMD lanes.
+///
+/// Spheres are numbered by their place in the arrays. Runs
+/// are given by their first sphere and count; the sphere
+/// skip is never reported as hit.
+////////////////////////////////////////////////////////////
+class SphereSoA
+{
+public:
+    static const size_t none = (size_t)-1;
+    SphereSoA();
+    SphereSoA(const SphereSoA& s);
+    SphereSoA& operator = (const SphereSoA& s);
+    void resize(const size_t size);
+    size_t size() const { return ir.size(); }
+    void set(const size_t i, const Vec3r& centre, const Real radius);
+    Vec3r centre(const size_t i) const { return Vec3r(cx[i], cy[i], cz[i]); }
+    Vec3r normal(const size_t i, const Vec3r& where) const { return (where - centre(i)) * ir[i]; }
+    Real intersect(const size_t i, const Ray& r) const;
+    void select(const SimdLevel level);         // clamped to what simdDetect allows
+    SimdLevel level() const { return simd; }
+    size_t closest(const SphereQuery& q, const size_t skip,
+        const size_t first, const size_t count, Real& t) const;
+    size_t any(const SphereQuery& q, const size_t skip,
+        const size_t first, const size_t count, const Real tmax) const;
+    void packet(const SpherePacket& p, const size_t first, const size_t count) const;
+    void save(CacheWriter& out) const;
+    bool attach(CacheReader& in, const size_t size);
+private:
+    typedef size_t(*Closest)(const SphereArrays&, const SphereQuery&, size_t, size_t, size_t, Real&);
+    typedef size_t(*Any)(const SphereArrays&, const SphereQuery&, size_t, size_t, size_t, Real);
+    typedef void(*Packet)(const SphereArrays&, const SpherePacket&, size_t, size_t);
+    Storage<Real, AlignedAllocator<Real> > cx, cy, cz, r2;
+    Storage<Real> ir;                           // 1 / radius, for the normals
+    SphereArrays arrays;                        // the data of cx, cy, cz and r2, rebound by every copy
+    SimdLevel simd;
+    Closest closestFn;
+    Any anyFn;
+    Packet packetFn;
+    void bind();
+};
+
+/* the kernels, one translation unit per instruction set */
+size_t sphereClosestScalar(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real& t);
+size_t sphereAnyScalar(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real tmax);
+void spherePacketScalar(const SphereArrays& s, const SpherePacket& p, size_t first, size_t count);
+#ifdef SIMD_X86
+size_t sphereClosestSSE2(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real& t);
+size_t sphereAnySSE2(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real tmax);
+void spherePacketSSE2(const SphereArrays& s, const SpherePacket& p, size_t first, size_t count);
+size_t sphereClosestAVX2(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real& t);
+size_t sphereAnyAVX2(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real tmax);
+void spherePacketAVX2(const SphereArrays& s, const SpherePacket& p, size_t first, size_t count);
+#endif
+#ifdef SIMD_AVX512
+size_t sphereClosestAVX512(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real& t);
+size_t sphereAnyAVX512(const SphereArrays& s, const SphereQuery& q, const size_t skip, size_t first, size_t count, Real tmax);
+void spherePacketAVX512(const SphereArrays& s, const SpherePacket& p, size_t first, size_t count);
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+#include "TextParse.h"          /* self definition */
+#include <stdlib.h>             /* strtod_l, _strtod_l */
+#include <string.h>             /* memcpy */
+#include <locale.h>             /* newlocale, _create_locale */
+#include <string>
+#if defined(__APPLE__)
+#include <xlocale.h>            /* strtod_l */
+#endif
+
+/* the "C" locale, created once, whose decimal point is always '.' */
+#if defined(_MSC_VER)
+static _locale_t numericLocale()
+{
+    static const _locale_t c = _create_locale(LC_NUMERIC, "C");
+    return c;
+}
+#define STRTOD_C(text) _strtod_l(text, nullptr, numericLocale())
+#else
+static locale_t numericLocale()
+{
+    static const locale_t c = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+    return c;
+}
+#define STRTOD_C(text) strtod_l(text, nullptr, numericLocale())
+#endif
+
+////////////////////////////////////////////////////////////
+/// Converting the number between first and last, as
+/// parseNumber has found it, with strtod in the "C" locale
+/// rather than the process's, so '.' is always the decimal
+/// point and the result is correctly rounded.
+///
+/// RETURNS: The double nearest to the number.
+////////////////////////////////////////////////////////////
+double parseDecimal(const char* first, const char* last)
+{
+    char token[64];
+    const size_t length = last - first;
+    if (length < sizeof(token))
+    {
+        memcpy(token, first, length);
+        token[length] = 0;
+        return STRTOD_C(token);
+    }
+    return STRTOD_C(std::string(first, last).c_str());
+}
@@ -0,0 +1,121 @@
+#ifndef _TEXTPARSE_H_
+#define _TEXTPARSE_H_
+
+#include <stddef.h>
+#include <string.h>             /* memchr */
+
+////////////////////////////////////////////////////////////
+/// Helpers of the text loaders, which parse mapped files in
+/// place: every function takes the current position and
+/// the end of the text and never reads past it.
+////////////////////////////////////////////////////////////
+
+inline bool isSpace(const char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline bool isLineEnd(const char c)
+{
+    return c == '\n' || c == '\r' || c == '#';
+}
+
+inline const char* skipSpaces(const char* p, const char* end)
+{
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+inline const char* nextLine(const char* p, const char* end)
+{
+    const char* n = (const char*)memchr(p, '\n', end - p);
+    return n ? n + 1 : end;
+}
+
+/* end of the token at p, which runs to a space or the end of the line */
+inline const char* tokenEnd(const char* p, const char* end)
+{
+    while (p < end && !isSpace(*p) && !isLineEnd(*p)) ++p;
+    return p;
+}
+
+double parseDecimal(const char* first, const char* last);      // nearest double, whatever the locale
+
+////////////////////////////////////////////////////////////
+/// Parsing a decimal number, sign, fraction and exponent
+/// optional, with '.' as the decimal point whatever the
+/// locale. Digits fitting in 53 bits scaled by a power of
+/// ten up to 22, which is all hand written files hold, are
+/// converted exactly in place; the others, such as the 17
+/// digits a double is written with, go to parseDecimal,
+/// strtod in the "C" locale, to be rounded correctly.
+///
+/// RETURNS: The end of the number, nullptr if there is none.
+////////////////////////////////////////////////////////////
+inline const char* parseNumber(const char* p, const char* end, double& value)
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* first = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *(p++) == '-';
+    unsigned long long mantissa = 0;
+    int exponent = 0, digits = 0, kept = 0;
+    bool dropped = false;                           /* digits past the 19 kept */
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+    {
+        if (kept < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) ++kept;
+        }
+        else
+        {
+            ++exponent;                             /* digits past what fits only scale */
+            dropped = true;
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+        {
+            if (kept < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) ++kept;
+                --exponent;
+            }
+            else
+                dropped = true;
+        }
+    }
+    if (!digits) return nullptr;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool below = false;
+        if (q < end && (*q == '-' || *q == '+')) below = *(q++) == '-';
+        if (q < end && *q >= '0' && *q <= '9')
+        {
+            int e = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; ++q)
+                if (e < 10000) e = e * 10 + (*q - '0');
+            exponent += below ? -e : e;
+            p = q;
+        }
+    }
+    if (dropped || mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+    {
+        value = parseDecimal(first, p);
+        return p;
+    }
+    double v = (double)mantissa;
+    if (exponent < 0)
+        v /= powers[-exponent];
+    else if (exponent > 0)
+        v *= powers[exponent];
+    value = negative ? -v : v;
+    return p;
+}
+
+#endif
@@ -0,0 +1,112 @@
+#include "ThreadPool.h"         /* self definition */
+#include "Timeline.h"
+#include <string>               /* to_string */
+
+static std::atomic<size_t> pools(0);
+
+ThreadPool::ThreadPool(const size_t threads) :
+    pending(0), job(nullptr), generation(0), number(++pools), quit(false)
+{
+    size_t count = threads ? threads : std::thread::hardware_concurrency();
+    if (!count) count = 1;
+    for (size_t i = 0; i < count; ++i)
+        queues.push_back(std::unique_ptr<Queue>(new Queue));
+    for (size_t i = 1; i < count; ++i)                  /* worker 0 is the caller of run() */
+        workers.push_back(std::thread(&ThreadPool::loop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+}
+
+////////////////////////////////////////////////////////////
+/// Splits [0, tasks) into contiguous runs, one per worker,
+/// so neighbouring tasks start on the same thread, then
+/// works alongside the pool until every task has finished.
+////////////////////////////////////////////////////////////
+void ThreadPool::run(const size_t tasks, const Job& j)
+{
+    if (!tasks) return;
+    std::lock_guard<std::mutex> running(runLock);
+    const size_t count = queues.size();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job = &j;
+        pending = tasks;
+        for (size_t w = 0; w < count; ++w)
+        {
+            std::lock_guard<std::mutex> q(queues[w]->lock);
+            queues[w]->front = tasks * w / count;
+            queues[w]->back = tasks * (w + 1) / count;
+        }
+        ++generation;
+    }
+    wake.notify_all();
+    execute(0);
+
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this]() { return pending == 0; });
+    job = nullptr;
+}
+
+////////////////////////////////////////////////////////////
+/// Takes the next task of a worker, stealing from the other
+/// queues when its own one is empty.
+///
+/// RETURNS: false when no task is left anywhere.
+////////////////////////////////////////////////////////////
+bool ThreadPool::pop(const size_t worker, size_t& task)
+{
+    const size_t count = queues.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        Queue& q = *queues[(worker + i) % count];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.front < q.back)
+        {
+            if (i == 0)                                 /* own queue, in order */
+                task = q.front++;
+            else                                        /* steal from the far end */
+                task = --q.back;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::execute(const size_t worker)
+{
+    size_t task;
+    while (pop(worker, task))
+    {
+        (*job)(task, worker);
+        if (--pending == 0)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::loop(const size_t worker)
+{
+    timelineNameThread(("pool " + std::to_string(number) + ", worker " + std::to_string(worker)).c_str());
+    size_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&]() { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+        execute(worker);
+    }
+}
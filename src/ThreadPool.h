@@ -0,0 +1,51 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+////////////////////////////////////////////////////////////
+/// Persistent work-stealing pool. The thread calling run()
+/// takes part as worker 0, so a pool of one thread runs
+/// every task inline. Each worker owns a contiguous run of
+/// task indices, pops from its front and steals from the
+/// back of the others once it runs dry; a run allocates
+/// nothing.
+////////////////////////////////////////////////////////////
+class ThreadPool
+{
+public:
+    typedef std::function<void(const size_t task, const size_t worker)> Job;
+    explicit ThreadPool(const size_t threads = 0);  // 0 - one per hardware thread
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+    size_t size() const { return queues.size(); }
+    void run(const size_t tasks, const Job& job);   // blocks until all tasks are done
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        size_t front, back;     // tasks [front, back) left
+        Queue() : front(0), back(0) {}
+    };
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+    std::mutex lock, runLock;
+    std::condition_variable wake, done;
+    std::atomic<size_t> pending;
+    const Job* job;
+    size_t generation;
+    size_t number;              // of the pools created so far, naming its threads on timelines
+    bool quit;
+    bool pop(const size_t worker, size_t& task);
+    void execute(const size_t worker);
+    void loop(const size_t worker);
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "Timeline.h"           /* self definition */
+#include <stdio.h>              /* fopen, fprintf */
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>               /* steady_clock */
+
+std::atomic<bool> timelineRecording(false);
+
+struct TimelineEvent
+{
+    const char* name;
+    const char* argName;
+    long long arg;
+    long long begin, end;       // nanoseconds since timelineStart
+};
+
+struct TimelineThread
+{
+    std::string name;           // empty - "thread <tid>"
+    std::vector<TimelineEvent> events;
+    bool retired;               // its thread has exited; taken over by the next one once its events are dropped
+};
+
+static std::mutex registryLock;                             /* guards threads and retired, not the events */
+static std::vector<std::unique_ptr<TimelineThread> > threads;   /* tid is the index + 1 */
+static std::atomic<long long> origin(0);
+
+/* the buffer of a thread, retired when the thread exits so pools created one after another reuse the entries */
+struct TimelineOwner
+{
+    TimelineThread* thread;
+    ~TimelineOwner()
+    {
+        if (!thread) return;
+        std::lock_guard<std::mutex> guard(registryLock);
+        thread->retired = true;
+    }
+};
+static thread_local TimelineOwner current = { nullptr };
+
+static long long clockNs()
+{
+    return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* the buffer of the calling thread, on first use the one of an exited thread with nothing left to write, or a new one */
+static TimelineThread& own()
+{
+    if (!current.thread)
+    {
+        std::lock_guard<std::mutex> guard(registryLock);
+        for (std::unique_ptr<TimelineThread>& t : threads)
+            if (t->retired && t->events.empty())
+            {
+                current.thread = t.get();
+                break;
+            }
+        if (!current.thread)
+        {
+            threads.push_back(std::unique_ptr<TimelineThread>(new TimelineThread));
+            current.thread = threads.back().get();
+            current.thread->events.reserve(1024);
+        }
+        current.thread->name.clear();
+        current.thread->retired = false;
+    }
+    return *current.thread;
+}
+
+/* a JSON string of s, only quotes and backslashes needing escapes in our names */
+static void putString(FILE* file, const char* s)
+{
+    fputc('"', file);
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\') fputc('\\', file);
+        if ((unsigned char)*s >= ' ') fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+void timelineStart()
+{
+    {
+        std::lock_guard<std::mutex> guard(registryLock);
+        for (std::unique_ptr<TimelineThread>& t : threads)
+            t->events.clear();
+    }
+    origin = clockNs();
+    timelineRecording = true;
+}
+
+void timelineStop()
+{
+    timelineRecording = false;
+}
+
+void timelineNameThread(const char* name)
+{
+    own().name = name;
+}
+
+long long timelineNow()
+{
+    return clockNs() - origin.load(std::memory_order_relaxed);
+}
+
+void timelineRecord(const char* name, const char* argName, const long long arg, const long long begin)
+{
+    const TimelineEvent e = { name, argName, arg, begin, timelineNow() };
+    own().events.push_back(e);
+}
+
+////////////////////////////////////////////////////////////
+/// Every span is a complete ("X") event of process 1, on
+/// the thread that recorded it, named by a metadata event;
+/// times are in microseconds.
+////////////////////////////////////////////////////////////
+bool timelineWrite(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    std::lock_guard<std::mutex> guard(registryLock);
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"rtr\"}}");
+    for (size_t tid = 1; tid <= threads.size(); ++tid)
+    {
+        const TimelineThread& t = *threads[tid - 1];
+        if (t.retired && t.events.empty())
+            continue;
+        fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": ", tid);
+        putString(file, t.name.empty() ? ("thread " + std::to_string(tid)).c_str() : t.name.c_str());
+        fprintf(file, "}},\n{\"name\": \"thread_sort_index\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"sort_index\": %zu}}", tid, tid);
+        for (const TimelineEvent& e : t.events)
+        {
+            fprintf(file, ",\n{\"name\": ");
+            putString(file, e.name);
+            fprintf(file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %zu, \"ts\": %.3f, \"dur\": %.3f", tid, e.begin / 1e3, (e.end - e.begin) / 1e3);
+            if (e.argName)
+            {
+                fprintf(file, ", \"args\": {");
+                putString(file, e.argName);
+                fprintf(file, ": %lld}", e.arg);
+            }
+            fputc('}', file);
+        }
+    }
+    const bool ok = fprintf(file, "\n]}\n") > 0;
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,57 @@
+#ifndef _TIMELINE_H_
+#define _TIMELINE_H_
+
+#include <stddef.h>
+#include <atomic>
+
+////////////////////////////////////////////////////////////
+/// Timeline of the phases threads go through, for finding
+/// idle workers and unbalanced tiles. Spans are recorded
+/// once timelineStart is called, each thread into a buffer
+/// of its own, and written as Chrome trace events that
+/// chrome://tracing and ui.perfetto.dev open. Not started,
+/// a span costs one relaxed load.
+////////////////////////////////////////////////////////////
+void timelineStart();                                   // drops what was recorded, restarts the clock
+void timelineStop();
+void timelineNameThread(const char* name);              // of the calling thread, from now on
+
+////////////////////////////////////////////////////////////
+/// Writing what was recorded as trace event JSON. Threads
+/// still recording while it runs are not allowed.
+///
+/// RETURNS: false when the file cannot be written.
+////////////////////////////////////////////////////////////
+bool timelineWrite(const char* path);
+
+extern std::atomic<bool> timelineRecording;
+long long timelineNow();                                // nanoseconds since timelineStart
+void timelineRecord(const char* name, const char* argName, const long long arg, const long long begin);
+
+////////////////////////////////////////////////////////////
+/// The lifetime of a span is one event on the timeline of
+/// its thread. Names and argument names are not copied and
+/// have to be string literals.
+////////////////////////////////////////////////////////////
+class TimelineSpan
+{
+public:
+    explicit TimelineSpan(const char* _name, const char* _argName = nullptr, const long long _arg = 0) :
+        name(_name), argName(_argName), arg(_arg),
+        begin(timelineRecording.load(std::memory_order_relaxed) ? timelineNow() : -1)
+    {
+    }
+    ~TimelineSpan()
+    {
+        if (begin >= 0) timelineRecord(name, argName, arg, begin);
+    }
+    TimelineSpan(const TimelineSpan&) = delete;
+    TimelineSpan& operator = (const TimelineSpan&) = delete;
+private:
+    const char* name;
+    const char* argName;        // nullptr - no argument
+    long long arg;
+    long long begin;            // -1 when not recording
+};
+
+#endif
@@ -1,41 +1,45 @@
 #include "Trace.h"              /* self definition */
-#include <math.h>               /* sqrt */
+#include "SceneCache.h"
+#include "Timeline.h"
+#include "Simd.h"               /* SIMD_X86 */
+#include <math.h>               /* sqrt, fabs */
+#include <string.h>             /* memcpy */
+#include <algorithm>            /* min */
+#include <chrono>               /* steady_clock */
+#ifdef SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>             /* __rdtsc */
+#else
+#include <x86intrin.h>          /* __rdtsc */
+#endif
+#endif
 
 ////////////////////////////////////////////////////////////
-///Constructing a ray from a point and a vector.
+///Finding intersections of the first lanes of a packet,
+///one ray at a time unless an object knows better.
 ////////////////////////////////////////////////////////////
-Ray::Ray(const Vec3d& from, const Vec3d& vector) :
-    start(from), codirected(vector)
+void BaseObject::intersect(const RayPacket& p, const size_t lanes, Real* t) const
 {
-}
-
-////////////////////////////////////////////////////////////
-///Returns point at distance t from the origine.         
-///                                                       
-///RETURNS: Constructed vertex
-////////////////////////////////////////////////////////////
-Vec3d Ray::onRay(const double f) const
-{
-    return Vec3d(start + codirected * f);
+    for (size_t l = 0; l < lanes; ++l)
+        t[l] = intersect(p.ray(l));
 }
 
 ////////////////////////////////////////////////////////////
 ///Finding intersection of a ray with a sphere.           
 ///                                                        
-///RETURNS: Distance from the origine of the ray.         
+///RETURNS: Distance from the origine of the ray, -1 when
+///         it is not within (tmin, tmax).
 ////////////////////////////////////////////////////////////
-double Sphere::intersect(const Ray& r) const
+Real Sphere::intersect(const Ray& r) const
 {
-    const Vec3d d(r.start - centre);
-    const double a = r.codirected.dot(r.codirected),
-        b = 2 * r.codirected.dot(d),
+    const Vec3r d(r.start - centre);
+    const Real b = r.direction.dot(d),                /* half b, the direction is unit */
         c = d.dot(d) - radius * radius,
-        det = b * b - 4 * a * c;    //根的判断
-
-    if (det < 0.0) return -1.0;                      /* no intersection */
-    if (det == 0.0) return(-b / (2.0 * a));               /* one intersection */
+        det = b * b - c;    //根的判断
 
-    return(((a > 0.0) ? -sqrt(det) : sqrt(det)) - b) / (2.0 * a);/* closest intersection */
+    if (det < 0.0 || -b <= r.tmin) return -1.0;      /* no intersection, or behind tmin */
+    const Real t = -b - sqrt(det);                   /* closest intersection */
+    return r.within(t) ? t : -1.0;
 }
 
 ////////////////////////////////////////////////////////////
@@ -43,22 +47,28 @@ double Sphere::intersect(const Ray& r) const
 ///                                                        
 ///RETURNS: The normal vector.                            
 ////////////////////////////////////////////////////////////
-Vec3d Sphere::normal(const Vec3d& where) const
+Vec3r Sphere::normal(const Vec3r& where) const
 {
     return ((where - centre).unit());
 }
 
+BBox Sphere::bounds() const
+{
+    const Vec3d c(centre), r(radius, radius, radius);
+    return BBox(c - r, c + r);
+}
+
 ////////////////////////////////////////////////////////////
 /// Computes plane equation and the equations delimiting   
 /// the edges.                                             
 ////////////////////////////////////////////////////////////
 void TPolygon::init()
 {
-    inormal = (Vec3d(vertices[2], vertices[1]) * Vec3d(vertices[1], vertices[0])).unit();
+    inormal = (Vec3r(vertices[2], vertices[1]) * Vec3r(vertices[1], vertices[0])).unit();
     /* normal to the plane */
 
     for (size_t i = 0; i < vertices.size() - 1; ++i)           /* finding equations for edges */
-        edges.push_back(Plane(inormal * Vec3d(vertices[i], vertices[i + 1]), vertices[i]));
+        edges.push_back(Plane<Real>(inormal * Vec3r(vertices[i], vertices[i + 1]), vertices[i]));
 }
 
 ////////////////////////////////////////////////////////////
@@ -66,26 +76,18 @@ void TPolygon::init()
 ///                                                        
 /// RETURNS: Distance from the origine of the ray.         
 ////////////////////////////////////////////////////////////
-double TPolygon::intersect(const Ray& r) const
+Real TPolygon::intersect(const Ray& r) const
 {
-    const double s2 = r.codirected.dot(inormal);
-    if (s2 == 0.0)
-        return -1.0f;
-    else
-    {
-        const double t = (vertices[0] - r.start).dot(inormal) / s2;
-        if (t < 0.0)
-            return -1.0;
-        else
-        {
-            const Vec3d a(r.onRay(t));
-            const size_t size = vertices.size() - 1;
-            for (size_t i = 0; i < size; ++i)
-                if (edges[i].vertexOnPlane(a) > 0.0)
-                    return -1.0;
-            return t;
-        }
-    }
+    return polygonHit(inormal, vertices[0], edges.data(), vertices.size() - 1, r);
+}
+
+////////////////////////////////////////////////////////////
+/// Finding intersections of the first lanes of a packet
+/// with a polygon.
+////////////////////////////////////////////////////////////
+void TPolygon::intersect(const RayPacket& p, const size_t lanes, Real* t) const
+{
+    polygonHit(inormal, vertices[0], edges.data(), vertices.size() - 1, p, lanes, t);
 }
 
 ////////////////////////////////////////////////////////////
@@ -93,12 +95,79 @@ double TPolygon::intersect(const Ray& r) const
 ///                                                        
 /// RETURNS: The Normal vector.                            
 ////////////////////////////////////////////////////////////
-Vec3d TPolygon::normal(const Vec3d& where) const
+Vec3r TPolygon::normal(const Vec3r& /*where*/) const
 {
     return inormal;
 }
 
-Camera::Camera(const Vec3d & _viewer, const Vec3d & _screen, const Vec3d & _screenU, const Vec3d & _screenV):
+BBox TPolygon::bounds() const
+{
+    BBox b;
+    for (const Vec3r& v : vertices)
+        b.extend(Vec3d(v));
+    return b;
+}
+
+////////////////////////////////////////////////////////////
+/// Finding the closest triangle hit by a ray, one by one.
+/// Only for callers holding the mesh; traces go through
+/// the BVH, which has every triangle on its own.
+///
+/// RETURNS: Distance from the origine of the ray.
+////////////////////////////////////////////////////////////
+Real TriangleMesh::intersect(const Ray& r) const
+{
+    Ray ray(r);
+    Real t = -1.0;
+    for (size_t i = 0, size = triangles(); i < size; ++i)
+    {
+        const Real d = triangleHit(corner(i, 0), corner(i, 1), corner(i, 2), ray);
+        if (d >= 0.0)
+            t = ray.tmax = d;
+    }
+    return t;
+}
+
+////////////////////////////////////////////////////////////
+/// Returns the normal of the triangle whose plane lies
+/// closest to where.
+///
+/// RETURNS: The normal vector.
+////////////////////////////////////////////////////////////
+Vec3r TriangleMesh::normal(const Vec3r& where) const
+{
+    Vec3r best(0, 0, 0);
+    Real closest = -1.0;
+    for (size_t i = 0, size = triangles(); i < size; ++i)
+    {
+        const Vec3r a(corner(i, 0)), n((Vec3r(a, corner(i, 1)) * Vec3r(a, corner(i, 2))).unit());
+        const Real d = fabs(Vec3r(a, where).dot(n));
+        if (closest < 0.0 || d < closest)
+        {
+            closest = d;
+            best = n;
+        }
+    }
+    return best;
+}
+
+BBox TriangleMesh::bounds() const
+{
+    BBox b;
+    for (const Vec3f& v : positions)
+        b.extend(Vec3d(v));
+    return b;
+}
+
+BBox TriangleMesh::partBounds(const size_t part) const
+{
+    BBox b;
+    for (int i = 0; i < 3; ++i)
+        b.extend(Vec3d(positions[indices[3 * part + i]]));
+    return b;
+}
+
+Camera::Camera(const Vec3r & _viewer, const Vec3r & _screen, const Vec3r & _screenU, const Vec3r & _screenV):
     viewer(_viewer), screen(_screen), screenU(_screenU), screenV(_screenV)
 {
 }
@@ -109,7 +178,7 @@ Camera::Camera(const Vec3d & _viewer, const Vec3d & _screen, const Vec3d & _scre
 ///projection plane, screen_u and screen_v orientation 
 ///of the projection plane in the world space.  
 ////////////////////////////////////////////////////////////
-void Camera::set(const Vec3d & _viewer, const Vec3d & _screen, const Vec3d & _screenU, const Vec3d & _screenV)
+void Camera::set(const Vec3r & _viewer, const Vec3r & _screen, const Vec3r & _screenU, const Vec3r & _screenV)
 {
     viewer.set(_viewer);
     screen.set(_screen);
@@ -117,45 +186,348 @@ void Camera::set(const Vec3d & _viewer, const Vec3d & _screen, const Vec3d & _sc
     screenV.set(_screenV);
 }
 
-Ray Camera::genRay(const double xpos, const double ypos) const
+Ray Camera::genRay(const Real xpos, const Real ypos) const
 {
     return Ray(viewer, (screenU * xpos) + (screenV * ypos) + screen - viewer);
 }
 
-void Renderer::init()
+RenderStats::RenderStats() :
+    shadowRays(0), occluded(0), cacheTests(0), cacheHits(0), paths(0), reflectionRays(0), hits(0), cutoffs(0)
+{
+}
+
+RenderStats& RenderStats::operator += (const RenderStats& s)
+{
+    shadowRays += s.shadowRays;
+    occluded += s.occluded;
+    cacheTests += s.cacheTests;
+    cacheHits += s.cacheHits;
+    paths += s.paths;
+    reflectionRays += s.reflectionRays;
+    hits += s.hits;
+    cutoffs += s.cutoffs;
+    traversal += s.traversal;
+    return *this;
+}
+
+double RenderStats::cacheHitRate() const
+{
+    return cacheTests ? double(cacheHits) / double(cacheTests) : 0.0;
+}
+
+double RenderStats::averageDepth() const
+{
+    return paths ? double(hits) / double(paths) : 0.0;
+}
+
+void TraceContext::reset(const size_t lights, const Real _cutoff)
+{
+    occluders.assign(lights, PrimitiveStore::none);
+    cutoff = _cutoff;
+    stats = RenderStats();
+}
+
+Renderer::Renderer() :
+    threads(0), tileSize(16), bvhMode(BVH::SAH), simd(simdDetect()), packetSize(0), cutoff(Real(1.0 / 256)),
+    costMode(CostNone)
+{
+}
+
+/* running total of what mode measures, per pixel costs being differences of it */
+static unsigned long long costClock(const PixelCost mode, const TraceContext& ctx)
+{
+    if (mode == CostTests)
+    {
+        unsigned long long work = ctx.stats.traversal.nodes;
+        for (const unsigned long long t : ctx.stats.traversal.tests)
+            work += t;
+        return work;
+    }
+#ifdef SIMD_X86
+    return __rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+////////////////////////////////////////////////////////////
+/// Filling a packet with the rays of a width x height block
+/// of pixels starting at (xpos, ypos), lane = x * height + y.
+////////////////////////////////////////////////////////////
+void Camera::genPacket(RayPacket & p, const Real xpos, const Real ypos, const int width, const int height) const
+{
+    p.size = 0;
+    p.start = viewer;
+    for (int x = 0; x < width; ++x)
+        for (int y = 0; y < height; ++y, ++p.size)
+        {
+            const Vec3r d(genRay(xpos + x, ypos + y).direction);
+            p.dx[p.size] = d.x;
+            p.dy[p.size] = d.y;
+            p.dz[p.size] = d.z;
+        }
+}
+
+////////////////////////////////////////////////////////////
+/// Getting the scene ready to capture: building the BVH
+/// over its objects or, for a scene loaded from a cache,
+/// checking the BVH it came with.
+///
+/// RETURNS: false when a cached scene fails its checks;
+///          true otherwise.
+////////////////////////////////////////////////////////////
+bool Renderer::init()
+{
+    const TimelineSpan span("init");
+    if (scene->cache)
+    {
+        const TimelineSpan validate("bvh validate");
+        return scene->bvh.validate(simd);
+    }
+    {
+        const TimelineSpan objects("object init");
+        for (BaseObject* o : scene->objects)
+            o->init();
+    }
+    scene->bvh.build(scene->objects, bvhMode, &workers(), simd);
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Returns the worker pool, (re)creating it when the
+/// requested thread count has changed.
+////////////////////////////////////////////////////////////
+ThreadPool& Renderer::workers()
 {
-    for (BaseObject* o : scene->objects)
-        o->init();
+    const size_t count = threads ? threads : std::thread::hardware_concurrency();
+    if (!pool || (count && pool->size() != count))
+        pool.reset(new ThreadPool(threads));
+    return *pool;
 }
 
+/* what every tile of a capture needs, taken by one reference so the pool's job fits in std::function without allocating */
+struct CaptureFrame
+{
+    unsigned char* pixels;
+    size_t xStep, yStep;        // bytes from a pixel to the next one along x, along y
+    PixelFormat format;
+    int xSize, ySize;
+    const Camera* camera;
+    size_t depth;
+    float* cost;                // per pixel, column by column; nullptr for CostNone
+};
+
+/* the light of a pixel, stored in the frame's format */
+static inline void store(unsigned char* p, const PixelFormat format, const Vec3r& l)
+{
+    if (format == PixelRGBA32F)
+    {
+        const float rgba[4] = { float(l.x), float(l.y), float(l.z), 1.0f };
+        memcpy(p, rgba, sizeof(rgba));          /* rows may be of any stride */
+        return;
+    }
+    p[0] = l.x * 256;
+    p[1] = l.y * 256;
+    p[2] = l.z * 256;
+    if (format == PixelRGBA8) p[3] = 255;
+}
+
+////////////////////////////////////////////////////////////
+/// Rendering a frame into memory it allocates, the way the
+/// viewer uploads it.
+///
+/// RETURNS: RGBA pixels, column by column, owned by the caller.
+////////////////////////////////////////////////////////////
 unsigned char* Renderer::capture(const int xSize, const int ySize, const size_t camID, const size_t depth)
 {
-    Vec3d l;//light
-    int coord[2];
     unsigned char* res = new unsigned char[xSize * ySize * 4];
-    unsigned char* p = res;
-    for (coord[0] = 0; coord[0] < xSize; ++coord[0])
-        for (coord[1] = 0; coord[1] < ySize; ++coord[1])           /* for each pixel on screen */
+    const CaptureFrame frame = { res, (size_t)ySize * 4, 4, PixelRGBA8, xSize, ySize, cameras[camID].get(), depth, nullptr };
+    render(frame);
+    return res;
+}
+
+////////////////////////////////////////////////////////////
+/// Rendering a frame of frame's size into its pixels, in
+/// its format. Once a first frame has been rendered, later
+/// ones of no more pixels, workers and lights allocate
+/// nothing.
+////////////////////////////////////////////////////////////
+void Renderer::capture(Framebuffer& frame, const size_t camID, const size_t depth)
+{
+    const CaptureFrame f = { frame.data(), pixelSize(frame.format()), frame.stride(), frame.format(),
+        frame.width(), frame.height(), cameras[camID].get(), depth, nullptr };
+    render(f);
+}
+
+////////////////////////////////////////////////////////////
+/// Rendering a frame. The screen is cut into tiles which
+/// are traced in parallel; every pixel only depends on the
+/// scene, so the result matches a single threaded run.
+/// Each worker traces with its own context, kept from one
+/// frame to the next, whose counters are summed into stats
+/// at the end. Unless costMode is CostNone, the cost of
+/// every pixel is recorded in cost; a packet's is shared
+/// evenly by its pixels.
+////////////////////////////////////////////////////////////
+void Renderer::render(CaptureFrame f)
+{
+    const TimelineSpan span("capture");
+    const int tile = tileSize > 0 ? tileSize : 16;
+    const int xTiles = (f.xSize + tile - 1) / tile, yTiles = (f.ySize + tile - 1) / tile;
+    if (costMode != CostNone)
+    {
+        cost.resize((size_t)f.xSize * f.ySize);
+        f.cost = cost.data();
+    }
+    else
+        cost.clear();
+
+    contexts.resize(workers().size());
+    for (TraceContext& ctx : contexts)
+        ctx.reset(scene->point_lights.size(), cutoff);
+    workers().run(xTiles * yTiles, [this, &f](const size_t task, const size_t worker)
+    {
+        renderTile(f, task, contexts[worker]);
+    });
+    stats = RenderStats();
+    for (const TraceContext& ctx : contexts)
+        stats += ctx.stats;
+}
+
+void Renderer::renderTile(const CaptureFrame& f, const size_t task, TraceContext& ctx) const
+{
+    const TimelineSpan span("tile", "tile", (long long)task);
+    const Camera& camera = *f.camera;
+    const int xSize = f.xSize, ySize = f.ySize;
+    const int tile = tileSize > 0 ? tileSize : 16, xTiles = (xSize + tile - 1) / tile;
+    const int packet = packetSize >= 8 ? 8 : packetSize >= 4 ? 4 : packetSize >= 2 ? 2 : 1;   /* down to 2, 4 or 8 */
+    const PixelCost mode = costMode;
+    Vec3r l;//light
+    const int x0 = int(task % xTiles) * tile, y0 = int(task / xTiles) * tile;
+    const int x1 = std::min(x0 + tile, xSize), y1 = std::min(y0 + tile, ySize);
+    if (packet > 1)
+    {
+        RayPacket rays;
+        Vec3r lights[PACKET_LANES];
+        for (int x = x0; x < x1; x += packet)
+            for (int y = y0; y < y1; y += packet)   /* for each block of the tile */
+            {
+                const int w = std::min(packet, x1 - x), h = std::min(packet, y1 - y);
+                camera.genPacket(rays, x - xSize / 2, y - ySize / 2, w, h);
+                for (int i = 0; i < w * h; ++i)
+                    lights[i].zero();
+                const unsigned long long before = f.cost ? costClock(mode, ctx) : 0;
+                scene->directPacket(ctx, lights, rays, camera.viewer, f.depth);
+                if (f.cost)
+                {
+                    const float share = float(costClock(mode, ctx) - before) / float(w * h);
+                    for (int i = 0; i < w * h; ++i)
+                        f.cost[(size_t)(x + i / h) * ySize + y + i % h] = share;
+                }
+                for (int i = 0; i < w * h; ++i)
+                    store(f.pixels + (x + i / h) * f.xStep + (y + i % h) * f.yStep, f.format, lights[i]);
+            }
+        return;
+    }
+    for (int x = x0; x < x1; ++x)
+    {
+        unsigned char* p = f.pixels + x * f.xStep + y0 * f.yStep;
+        for (int y = y0; y < y1; ++y, p += f.yStep)     /* for each pixel of the tile */
         {
+            const unsigned long long before = f.cost ? costClock(mode, ctx) : 0;
             //关键中的关键，计算环境光，返回pixel的照明度
-            scene->directRay(l.zero(), cameras[camID]->genRay(coord[0] - xSize / 2, coord[1] - ySize / 2), cameras[camID]->viewer, nullptr, depth);
-
-            *p = l.x * 256; p++;
-            *p = l.y * 256; p++;
-            *p = l.z * 256; p++;
-            *p = 255;       p++;
+            scene->directRay(ctx, l.zero(), camera.genRay(x - xSize / 2, y - ySize / 2), camera.viewer, PrimitiveStore::none, f.depth);
+            if (f.cost)
+                f.cost[(size_t)x * ySize + y] = float(costClock(mode, ctx) - before);
+            store(p, f.format, l);
         }
-    return res;
+    }
 }
 
 
+////////////////////////////////////////////////////////////
+/// Writing the cameras, the lights and the built BVH, prims
+/// included, to a scene cache, so later runs load them
+/// instead of parsing and building them. Renderer::init
+/// has to have run.
+///
+/// RETURNS: false when the file cannot be written or the
+///          scene holds objects the store cannot cache.
+////////////////////////////////////////////////////////////
+bool Scene::save(const char* path, const std::vector<std::shared_ptr<Camera> >& cameras) const
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    std::vector<PointLight> lights;
+    for (const PointLight* l : point_lights)
+        lights.push_back(*l);
+    std::vector<Camera> views;
+    for (const std::shared_ptr<Camera>& c : cameras)
+        views.push_back(*c);
+    CacheWriter out(file);
+    out.value(CacheHeader());
+    out.put(views.data(), views.size());
+    out.value(ambient);
+    out.put(lights.data(), lights.size());
+    const bool saved = bvh.save(out);
+    return (fclose(file) == 0) && out.good() && saved;
+}
+
+////////////////////////////////////////////////////////////
+/// Replacing the scene by the one of a cache, and cameras
+/// by its cameras. The file is mapped and the BVH views its
+/// arrays where they lie, so nothing is parsed or built and
+/// processes loading the same cache share its pages; the
+/// lights are copied into a block of the scene. Objects
+/// and lights the scene had in blocks are released.
+/// Renderer::init checks the BVH before the first capture.
+///
+/// RETURNS: false, leaving the scene and cameras as they
+///          were, when the file cannot be mapped or is not
+///          a cache of this build; true otherwise.
+////////////////////////////////////////////////////////////
+bool Scene::load(const char* path, std::vector<std::shared_ptr<Camera> >& cameras)
+{
+    std::shared_ptr<MappedFile> file(new MappedFile);
+    if (!file->open(path)) return false;
+    CacheReader in(file->data(), file->size());
+    CacheHeader header;
+    Vec3r world;
+    const Camera* views;
+    const PointLight* lights;
+    size_t viewCount, count;
+    if (!in.value(header) || !header.compatible() || !in.get(views, viewCount) || !in.value(world) ||
+        !in.get(lights, count))
+        return false;
+    BVH attached;
+    if (!attached.attach(in))
+        return false;
+    bvh = attached;
+    cache = file;
+    ambient = world;
+    objects.clear();
+    point_lights.clear();
+    blocks.clear();
+    PointLight* copies = count ? block<PointLight>(count) : nullptr;
+    for (size_t i = 0; i < count; ++i)
+    {
+        copies[i] = lights[i];
+        point_lights.push_back(copies + i);
+    }
+    cameras.clear();
+    for (size_t i = 0; i < viewCount; ++i)
+        cameras.push_back(std::shared_ptr<Camera>(new Camera(views[i])));
+    return true;
+}
+
 ////////////////////////////////////////////////////////////
 /// Computing illumination of a intersected surface point.                             
 ////////////////////////////////////////////////////////////
-void Scene::illuminate(Vec3d & light, PointLight * l, const Material & material, const Vec3d & normal, const Vec3d & where, const Vec3d & viewer)
+void Scene::illuminate(Vec3r & light, PointLight * l, const Material & material, const Vec3r & normal, const Vec3r & where, const Vec3r & viewer) const
 {
-    double diffuseratio, specularratio;
-    Vec3d lightvector((l->centre - where).unit());
+    Real diffuseratio, specularratio;
+    Vec3r lightvector((l->centre - where).unit());
     if ((diffuseratio = normal.dot(lightvector)) > 0)
     {
         light += l->intensity.blend(material.diffuse) * diffuseratio;//diffuse term 
@@ -166,63 +538,114 @@ void Scene::illuminate(Vec3d & light, PointLight * l, const Material & material,
 
 ////////////////////////////////////////////////////////////
 /// Casting a ray towards a lightsource to find out if    
-/// it is hidden by other objects or not.                 
+/// it is hidden by other objects or not. Neighbouring
+/// points tend to be hidden by the same prim, so the one
+/// that last hid the light is tried before the BVH.
 ///                                                       
-/// RETURNS: true light source visible; false otherwise.         
+/// RETURNS: true light source hidden; false otherwise.
 ////////////////////////////////////////////////////////////
-bool Scene::shadowRay(PointLight * l, const Vec3d & point, BaseObject * cur_obj) const
+bool Scene::shadowRay(TraceContext & ctx, const size_t light, const Vec3r & point, const unsigned int cur_obj) const
 {
-    double t = 0.0;
-    Ray r(point, l->centre - point);
-    for (BaseObject* i : objects)            /* finding intersection */
-        if (i != cur_obj)
+    const Vec3r toLight(point_lights[light]->centre - point);
+    const Ray r(point, toLight, toLight.length());
+    unsigned int& last = ctx.occluders[light];
+    RTR_STAT(++ctx.stats.shadowRays);
+    if (last != PrimitiveStore::none && last != cur_obj)
+    {
+        RTR_STAT(++ctx.stats.cacheTests);
+        RTR_STAT(++ctx.stats.traversal.tests[bvh.primitives().type(last)]);
+        const Real d = bvh.primitives().intersect(last, r);
+        if ((d > r.tmin) && (d <= r.tmax))
         {
-            t = i->intersect(r);
-            if ((t > 0) && (t <= 1)) return true;             /* first intersection is enough */
+            RTR_STAT(++ctx.stats.cacheHits);
+            RTR_STAT(++ctx.stats.occluded);
+            return true;
         }
-    return false;
+    }
+    const unsigned int hit = bvh.anyHit(r, cur_obj, ctx.stats.traversal);  /* first intersection is enough */
+    if (hit == PrimitiveStore::none) return false;
+    last = hit;
+    RTR_STAT(++ctx.stats.occluded);
+    return true;
 }
 
 ////////////////////////////////////////////////////////////
-/// Casting a ray into the world, recursing to compute    
-/// environmental reflections.                            
+/// Casting a ray into the world and following its        
+/// reflections.                                          
 ///                                                       
 /// RETURNS: Illumination for the pixel.                  
 ////////////////////////////////////////////////////////////
-void Scene::directRay(Vec3d & light, const Ray & r, const Vec3d& viewer, BaseObject * cur_obj, const size_t depth)
+void Scene::directRay(TraceContext & ctx, Vec3r & light, const Ray & r, const Vec3r& viewer, const unsigned int cur_obj, const size_t depth) const
+{
+    RTR_STAT(++ctx.stats.paths);
+    HitRecord hit;
+    if (depth && bvh.closestHit(r, cur_obj, hit, ctx.stats.traversal))                  // closest intersection, not with itself
+        shade(ctx, light, viewer, hit, depth);
+}
+
+////////////////////////////////////////////////////////////
+/// Casting a packet of primary rays into the world, then
+/// following each lane that hit something on its own.
+////////////////////////////////////////////////////////////
+void Scene::directPacket(TraceContext & ctx, Vec3r * light, RayPacket & p, const Vec3r & viewer, const size_t depth) const
 {
+    RTR_STAT(ctx.stats.paths += p.size);
     if (depth)
     {
-        BaseObject* obj = nullptr;
-        double minInterDist = 1E5f, t = 0.0;
-
-        for (BaseObject* i : objects)                   // finding intersection 
-            if (i != cur_obj)                           // with itself, no sense 
+        for (size_t i = 0; i < p.size; ++i)
+            p.t[i] = RAY_FAR;
+        bvh.closestHit(p, ctx.stats.traversal);
+        HitRecord hit;
+        for (size_t i = 0; i < p.size; ++i)
+            if (p.hit[i] != PrimitiveStore::none)
             {
-                t = i->intersect(r);
-                if ((t > 0) && (t < minInterDist))   // not behind the ray, valid intersection 
-                {
-                    minInterDist = t;                // finding closest intersection 
-                    obj = i;
-                }               
+                hit.t = p.t[i];
+                hit.prim = p.hit[i];
+                bvh.primitives().complete(p.ray(i), hit);
+                shade(ctx, light[i], viewer, hit, depth);
             }
-        if (obj)                           //got intersection
-        {
-            const Vec3d where(r.onRay(minInterDist)),   // intersection's coordinate 
-                normal(obj->normal(where)),             // of the current intersection
-                _viewer((viewer - where).unit());
-            Vec3d rlight;
+    }
+}
 
-            const size_t lsize = point_lights.size();   // illumination from each light 
-            for (size_t i = 0; i < lsize; ++i)     
-                if (!shadowRay(point_lights[i], where, obj))
-                    illuminate(light, point_lights[i], obj->material, normal, where, viewer);
+////////////////////////////////////////////////////////////
+/// Computing the illumination at a completed hit and at
+/// the surfaces its reflections go on to meet, at most
+/// depth of them. Each one adds its own light weighted by
+/// the product of the reflect coefs before it; once that
+/// weight falls under the context's cutoff, what is left
+/// could not show and is not traced.
+////////////////////////////////////////////////////////////
+void Scene::shade(TraceContext & ctx, Vec3r & light, const Vec3r & viewer, HitRecord hit, const size_t depth) const
+{
+    Real weight = 1;
+    for (size_t level = 1; ; ++level)
+    {
+        const Material& material = bvh.primitives().material(hit.material);
+        const unsigned int obj = hit.prim;
+        const Vec3r& where = hit.position,          // intersection's coordinate 
+            &normal = hit.normal;                   // of the current intersection
+        Vec3r local;
+        RTR_STAT(++ctx.stats.hits);
 
-            directRay(rlight.zero(), 
-                Ray(where, normal * normal.dot(_viewer) * 2.0 - _viewer/*refect*/), // recursive ray 
-                viewer, obj, depth - 1);
+        const size_t lsize = point_lights.size();   // illumination from each light 
+        local.zero();
+        for (size_t i = 0; i < lsize; ++i)
+            if (!shadowRay(ctx, i, where, obj))
+                illuminate(local, point_lights[i], material, normal, where, viewer);
+        light += (local + material.ambient.blend(ambient)) * weight;
 
-            light += rlight * obj->material.reflect + obj->material.ambient.blend(ambient);
+        weight *= material.reflect;
+        if (level == depth)
+            break;
+        if (weight <= ctx.cutoff)
+        {
+            RTR_STAT(++ctx.stats.cutoffs);
+            break;
         }
+        const Vec3r _viewer((viewer - where).unit());
+        const Ray reflected(where, normal * normal.dot(_viewer) * 2.0 - _viewer/*refect*/);
+        RTR_STAT(++ctx.stats.reflectionRays);
+        if (!bvh.closestHit(reflected, obj, hit, ctx.stats.traversal))   // the next surface, not the current one
+            break;
     }
 }
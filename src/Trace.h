@@ -4,30 +4,17 @@
 #include <vector>
 #include <memory>
 #include "Algebra.h"
-
-struct Material
-{
-    Vec3d ambient;            // 环境反射 - coefs of ambient reflection
-    Vec3d diffuse;            // 漫反射 - coefs of diffuse reflection
-    double specular;           // 镜面反射 - coef of specular reflection
-    double exponent;           // 镜面反射系数 - specular exponent
-    double reflect;            // 递归光线 - recursive ray
-};
+#include "Ray.h"
+#include "Material.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "BVH.h"
+#include "Framebuffer.h"
 
 struct PointLight
 {
-    Vec3d centre;             /* point light source */
-    Vec3d intensity;
-};
-
-class Ray
-{
-public:
-    Vec3d start;              // origin of the ray 
-    Vec3d codirected;         // a co-directed vector 
-    Ray() = default;
-    Ray(const Vec3d& from, const Vec3d& vector);
-    Vec3d onRay(const double f) const;
+    Vec3r centre;             /* point light source */
+    Vec3r intensity;
 };
 
 class BaseObject                 
@@ -35,67 +22,179 @@ class BaseObject
 public:
     Material material;              // material it is made of 
     virtual void init() {};
-    virtual double intersect(const Ray& r) const = 0;
-    virtual Vec3d normal(const Vec3d& where) const = 0;
+    virtual Real intersect(const Ray& r) const = 0;
+    virtual void intersect(const RayPacket& p, const size_t lanes, Real* t) const;
+    virtual Vec3r normal(const Vec3r& where) const = 0;
+    virtual BBox bounds() const = 0;
+    virtual size_t parts() const { return 1; }  // prims the BVH splits it into
+    virtual BBox partBounds(const size_t /*part*/) const { return bounds(); }
     virtual ~BaseObject() = default;
 };
 
 class Sphere :public BaseObject
 {
 public:
-    Vec3d centre;
-    double radius;
-    double intersect(const Ray& r) const;
-    Vec3d normal(const Vec3d& where) const;
+    Vec3r centre;
+    Real radius;
+    Real intersect(const Ray& r) const;
+    Vec3r normal(const Vec3r& where) const;
+    BBox bounds() const;
 };
 
 class TPolygon:public BaseObject
 {
 public:
-    Vec3d inormal;
-    std::vector<Plane> edges;   
-    std::vector<Vec3d> vertices;
+    Vec3r inormal;
+    std::vector<Plane<Real> > edges;   
+    std::vector<Vec3r> vertices;
     void init();
-    double intersect(const Ray& r) const;
-    Vec3d normal(const Vec3d& where) const;
+    Real intersect(const Ray& r) const;
+    void intersect(const RayPacket& p, const size_t lanes, Real* t) const;
+    Vec3r normal(const Vec3r& where) const;
+    BBox bounds() const;
+};
+
+////////////////////////////////////////////////////////////
+/// Triangles sharing a material and one vertex buffer,
+/// three 32 bit indices per triangle. The BVH takes each
+/// triangle as a prim of its own, which the store reads
+/// from these buffers in place.
+////////////////////////////////////////////////////////////
+class TriangleMesh :public BaseObject
+{
+public:
+    std::vector<Vec3f> positions;
+    std::vector<unsigned int> indices;      // 3 per triangle, into positions
+    size_t triangles() const { return indices.size() / 3; }
+    Vec3r corner(const size_t triangle, const int i) const { return Vec3r(positions[indices[3 * triangle + i]]); }
+    Real intersect(const Ray& r) const;
+    Vec3r normal(const Vec3r& where) const;
+    BBox bounds() const;
+    size_t parts() const { return triangles(); }
+    BBox partBounds(const size_t part) const;
 };
 
 class Camera
 {
 public:
-    Vec3d viewer;              /* position of the viewer */
-    Vec3d screen;              /* origine of the screen */
-    Vec3d screenU;            /* screen orientation vectors */
-    Vec3d screenV;
+    Vec3r viewer;              /* position of the viewer */
+    Vec3r screen;              /* origine of the screen */
+    Vec3r screenU;            /* screen orientation vectors */
+    Vec3r screenV;
     Camera(
-        const Vec3d& _viewer, const Vec3d& _screen,
-        const Vec3d& _screenU, const Vec3d& _screenV);
+        const Vec3r& _viewer, const Vec3r& _screen,
+        const Vec3r& _screenU, const Vec3r& _screenV);
     void set(
-        const Vec3d& _viewer, const Vec3d& _screen,
-        const Vec3d& _screenU, const Vec3d& _screenV);
-    Ray genRay(const double xpos, const double ypos) const;
+        const Vec3r& _viewer, const Vec3r& _screen,
+        const Vec3r& _screenU, const Vec3r& _screenV);
+    Ray genRay(const Real xpos, const Real ypos) const;
+    void genPacket(RayPacket& p, const Real xpos, const Real ypos, const int width, const int height) const;
 };
 
+////////////////////////////////////////////////////////////
+/// Counters of a capture, summed over its workers. Built
+/// with RTR_NO_STATS nothing is counted and they stay 0.
+////////////////////////////////////////////////////////////
+struct RenderStats
+{
+    unsigned long long shadowRays;      // one per light per shaded point
+    unsigned long long occluded;        // of them blocked before reaching the light
+    unsigned long long cacheTests;      // of them first tested against the light's last occluder
+    unsigned long long cacheHits;       // of those blocked by it, without a traversal
+    unsigned long long paths;           // rays cast from the camera
+    unsigned long long reflectionRays;  // rays cast from the surfaces they hit
+    unsigned long long hits;            // surfaces shaded along them, reflections included
+    unsigned long long cutoffs;         // paths ended under the cutoff weight before their depth
+    TraversalStats traversal;           // BVH nodes and prims tested by all of the rays above
+    RenderStats();
+    RenderStats& operator += (const RenderStats& s);
+    double cacheHitRate() const;        // cacheHits / cacheTests, 0 before any test
+    double averageDepth() const;        // hits / paths, 0 before any path
+};
+
+////////////////////////////////////////////////////////////
+/// What capture records of each pixel, to find where a
+/// frame's time goes.
+////////////////////////////////////////////////////////////
+enum PixelCost
+{
+    CostNone,
+    CostCycles,                 // time stamp counter ticks, steady clock nanoseconds off x86
+    CostTests                   // BVH nodes plus prims tested, 0 when built with RTR_NO_STATS
+};
+
+////////////////////////////////////////////////////////////
+/// What one worker keeps while tracing: the prim that last
+/// blocked each light, tested first by the next shadow ray
+/// towards it, and the worker's counters, on cache lines
+/// of its own.
+////////////////////////////////////////////////////////////
+struct alignas(CACHE_LINE) TraceContext
+{
+    std::vector<unsigned int> occluders;    // per light, PrimitiveStore::none if unknown
+    Real cutoff;                            // weight under which reflections are not followed
+    RenderStats stats;
+    void reset(const size_t lights, const Real _cutoff);
+};
+
+struct CaptureFrame;
+
 class Scene
 {
 public:
-    Vec3d ambient;            /* illumination of the world */
+    Vec3r ambient;            /* illumination of the world */
     std::vector<PointLight*> point_lights;
-    std::vector<BaseObject*> objects;
+    std::vector<BaseObject*> objects;   /* how scenes are built, traced from bvh.primitives() */
+    std::vector<std::shared_ptr<void> > blocks;   /* arrays generated objects and lights live in */
+    BVH bvh;                   /* built over objects by Renderer::init, or attached to cache */
+    std::shared_ptr<MappedFile> cache;  /* scene cache bvh views, if loaded from one */
+    template <class T> T* block(const size_t count)             /* count default constructed T the scene owns */
+    {
+        T* items = new T[count];
+        blocks.push_back(std::shared_ptr<T>(items, [](T* p) { delete[] p; }));
+        return items;
+    }
+    template <class T> T* keep(std::vector<T>& items)         /* items moved into a block the scene owns */
+    {
+        std::shared_ptr<std::vector<T> > kept(new std::vector<T>(std::move(items)));
+        blocks.push_back(kept);
+        return kept->data();
+    }
+    bool save(const char* path, const std::vector<std::shared_ptr<Camera> >& cameras) const;
+    bool load(const char* path, std::vector<std::shared_ptr<Camera> >& cameras);
     void illuminate(
-        Vec3d& light, PointLight *l, const Material& material,
-        const Vec3d& normal, const Vec3d& where, const Vec3d& viewer);
-    bool shadowRay(PointLight *l, const Vec3d& point, BaseObject* cur_obj) const;
-    void directRay(Vec3d& light, const Ray& r, const Vec3d& viewer, BaseObject* cur_obj, const size_t depth);
+        Vec3r& light, PointLight *l, const Material& material,
+        const Vec3r& normal, const Vec3r& where, const Vec3r& viewer) const;
+    bool shadowRay(TraceContext& ctx, const size_t light, const Vec3r& point, const unsigned int cur_obj) const;
+    void directRay(TraceContext& ctx, Vec3r& light, const Ray& r, const Vec3r& viewer, const unsigned int cur_obj, const size_t depth) const;
+    void directPacket(TraceContext& ctx, Vec3r* light, RayPacket& p, const Vec3r& viewer, const size_t depth) const;
+    void shade(TraceContext& ctx, Vec3r& light, const Vec3r& viewer, HitRecord hit, const size_t depth) const;
 };
 
 class Renderer
 {
 public:
-    void init();
+    Renderer();
+    bool init();
     std::shared_ptr<Scene> scene;
     std::vector<std::shared_ptr<Camera> > cameras;
+    size_t threads;             // worker threads of capture, 0 - one per hardware thread
+    int tileSize;               // edge of the square tiles the frame is split into
+    BVH::Mode bvhMode;          // build speed against trace speed of the hierarchy
+    SimdLevel simd;             // widest kernels to use, lowered to what the CPU has
+    int packetSize;             // primary rays traced as packetSize^2 packets (2, 4, 8, others rounded down), 0 - one by one
+    Real cutoff;                // reflections weighing less are dropped, 0 - always follow them to depth
+    RenderStats stats;          // counters of the last capture
+    PixelCost costMode;         // what capture records per pixel into cost
+    std::vector<float> cost;    // per pixel of the last capture, column by column; empty for CostNone
     unsigned char* capture(const int xSize, const int ySize, const size_t camID, const size_t depth = 10);
+    void capture(Framebuffer& frame, const size_t camID, const size_t depth = 10);
+    ThreadPool& workers();      // the pool capture runs on, to load scenes on the same threads
+private:
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<TraceContext, AlignedAllocator<TraceContext> > contexts;   // one per worker, kept between frames
+    void render(CaptureFrame f);
+    void renderTile(const CaptureFrame& f, const size_t task, TraceContext& ctx) const;
 };
 
 #endif
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////
+/// BVH::validate on hand built node arrays, as a crafted
+/// scene cache could hold them: it has to accept what build
+/// makes and reject any array a traversal could overflow
+/// its stack or leave the nodes on.
+////////////////////////////////////////////////////////////
+#include "Check.h"
+#include "Trace.h"
+#include "SceneCache.h"
+#include <vector>
+
+static BVH::Node leaf()
+{
+    BVH::Node n = { { -1, -1, -1 }, { 1, 1, 1 }, 0, 1, 0, 1 };    /* the one sphere */
+    return n;
+}
+
+static BVH::Node inner(const unsigned int second)
+{
+    BVH::Node n = { { -1, -1, -1 }, { 1, 1, 1 }, second, 0, 0, 0 };
+    return n;
+}
+
+/* a right leaning chain of levels inner nodes from first on, each with a leaf on the left */
+static void chain(std::vector<BVH::Node>& nodes, const size_t levels)
+{
+    for (size_t i = 0; i < levels; ++i)
+    {
+        const unsigned int at = (unsigned int)nodes.size();
+        nodes.push_back(inner(at + 2));
+        nodes.push_back(leaf());
+    }
+    nodes.push_back(leaf());
+}
+
+/* writing nodes with the prims of store as a cache, attaching a BVH to it and validating that */
+static bool validates(const std::vector<BVH::Node>& nodes, const PrimitiveStore& store)
+{
+    FILE* file = tmpfile();
+    if (!file) return false;
+    CacheWriter out(file);
+    BVH::Stats stats = {};
+    out.put(nodes.data(), nodes.size());
+    out.value(stats);
+    const bool saved = store.save(out) && out.good();
+    std::vector<char, AlignedAllocator<char> > data((size_t)ftell(file));
+    rewind(file);
+    const bool read = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    CHECK(saved && read);
+    CacheReader in(data.data(), data.size());
+    BVH bvh;
+    return bvh.attach(in) && bvh.validate(SimdScalar);
+}
+
+int main()
+{
+    Sphere sphere;
+    sphere.centre = Vec3r(0, 0, 0);
+    sphere.radius = 1;
+    BVH built;
+    built.build(std::vector<BaseObject*>(1, &sphere), BVH::SAH, nullptr, SimdScalar);
+    const PrimitiveStore& store = built.primitives();
+
+    std::vector<BVH::Node> nodes(1, leaf());
+    CHECK(validates(nodes, store));
+
+    nodes.clear();
+    chain(nodes, 20);
+    CHECK(validates(nodes, store));
+
+    nodes.clear();                                  /* deeper than any traversal stack */
+    chain(nodes, 200);
+    CHECK(!validates(nodes, store));
+
+    /* a child shared by a deep parent and a shallow later one: the path through the deep
+       one goes on down a chain the shallow one alone would leave within the stack */
+    nodes.clear();
+    nodes.push_back(inner(0));                      /* second child patched below */
+    chain(nodes, 40);
+    const unsigned int shallow = (unsigned int)nodes.size() - 1, shared = shallow + 2;
+    nodes[shallow - 2].offset = shared;             /* the chain's last inner node */
+    nodes[0].offset = shallow;
+    nodes[shallow] = inner(shared);
+    nodes.push_back(leaf());
+    chain(nodes, 50);
+    CHECK(!validates(nodes, store));
+
+    nodes.clear();                                  /* a second child outside its parent's range */
+    nodes.push_back(inner(3));
+    nodes.push_back(inner(4));
+    nodes.push_back(leaf());
+    nodes.push_back(leaf());
+    nodes.push_back(leaf());
+    CHECK(!validates(nodes, store));
+
+    nodes.clear();                                  /* nodes no parent reaches */
+    nodes.push_back(leaf());
+    nodes.push_back(leaf());
+    CHECK(!validates(nodes, store));
+
+    nodes.clear();                                  /* a child before its parent's next node */
+    nodes.push_back(inner(1));
+    nodes.push_back(leaf());
+    CHECK(!validates(nodes, store));
+
+    nodes.assign(1, leaf());                        /* a leaf past the prims */
+    nodes[0].offset = 1;
+    CHECK(!validates(nodes, store));
+    return checkResult();
+}
@@ -0,0 +1,40 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <stdio.h>              /* fprintf, fopen */
+#include <string.h>             /* strlen */
+
+////////////////////////////////////////////////////////////
+/// What the tests share: CHECK reports a failed condition
+/// with its line and carries on, so one run lists every
+/// failure; main returns checkResult() for ctest.
+////////////////////////////////////////////////////////////
+static int checkFailures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++checkFailures; \
+        } \
+    } while (0)
+
+static inline int checkResult()
+{
+    if (checkFailures) fprintf(stderr, "%d checks failed\n", checkFailures);
+    return checkFailures ? 1 : 0;
+}
+
+/* writes text to path, in the directory ctest runs the test from */
+static inline bool writeText(const char* path, const char* text)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    const size_t length = strlen(text);
+    const bool ok = fwrite(text, 1, length, file) == length;
+    return fclose(file) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////
+/// Framebuffers: strides shorter than a row refused, and a
+/// capture into rows of the caller's memory with padding
+/// rendering the frame a packed one gets while leaving the
+/// padding alone.
+////////////////////////////////////////////////////////////
+#include "Check.h"
+#include "Trace.h"
+#include "SceneGen.h"
+#include <string.h>             /* memcmp */
+#include <vector>
+
+static void testStrides()
+{
+    Framebuffer frame;
+    CHECK(frame.resize(8, 4));
+    CHECK(frame.stride() == 8 * 4 && frame.data());
+    CHECK(frame.resize(8, 4, PixelRGB8, 8 * 3));
+    CHECK(!frame.resize(8, 4, PixelRGBA8, 8 * 4 - 1));
+    CHECK(frame.width() == 0 && frame.height() == 0 && !frame.data());
+    CHECK(!frame.resize(8, 4, PixelRGBA32F, 8 * 4));
+
+    std::vector<unsigned char> pixels(4 * 8 * 16 * 2);             /* 4 rows of 8 float pixels, padded to twice that */
+    CHECK(frame.attach(pixels.data(), 8, 4, PixelRGBA32F, 8 * 16 * 2));
+    CHECK(frame.data() == pixels.data() && frame.width() == 8);
+    CHECK(!frame.attach(pixels.data(), 8, 4, PixelRGBA32F, 8 * 16 - 4));
+    CHECK(frame.width() == 0 && !frame.data());
+    CHECK(!frame.attach(nullptr, 8, 4));
+}
+
+static void testPadded()
+{
+    SceneSpec spec;
+    spec.prims = 30;
+    Renderer r;
+    r.threads = 2;
+    generateScene(r, spec);
+    CHECK(r.init());
+    const int size = 24;
+    const size_t row = size * 4, stride = row + 40;
+    Framebuffer packed(size, size);
+    r.capture(packed, 0, 3);
+    std::vector<unsigned char> pixels(stride * size, 0xab);
+    Framebuffer padded;
+    CHECK(padded.attach(pixels.data(), size, size, PixelRGBA8, stride));
+    r.capture(padded, 0, 3);
+    for (int y = 0; y < size; ++y)
+    {
+        CHECK(!memcmp(packed.row(y), pixels.data() + y * stride, row));
+        for (size_t x = row; x < stride; ++x)
+            CHECK(pixels[y * stride + x] == 0xab);
+    }
+}
+
+int main()
+{
+    testStrides();
+    testPadded();
+    return checkResult();
+}
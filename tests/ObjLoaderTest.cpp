@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////
+/// OBJ meshes: positions and fans of faces in every corner
+/// syntax, the same mesh from the parallel loader, and
+/// faces that are malformed or out of range failing.
+////////////////////////////////////////////////////////////
+#include "Check.h"
+#include "Trace.h"
+#include "ObjLoader.h"
+#include "ThreadPool.h"
+#include <string>
+
+static void testLoad()
+{
+    CHECK(writeText("mesh_load.obj",
+        "# a quad and a triangle\n"
+        "o quad\n"
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "v 1.5e0 1 -0.25\n"
+        "v 0 1 0  # comment\n"
+        "vt 0 0\n"
+        "vn 0 0 1\n"
+        "f 1 2 3 4\n"
+        "f 1/1/1 3/1/1 4//1\n"
+        "f -4 -3 -2\r\n"));
+    TriangleMesh mesh;
+    ObjStats stats;
+    CHECK(loadObj(mesh, "mesh_load.obj", nullptr, &stats));
+    CHECK(mesh.positions.size() == 4 && stats.vertices == 4);
+    CHECK(mesh.triangles() == 4 && stats.triangles == 4);
+    if (mesh.positions.size() != 4 || mesh.triangles() != 4) return;
+    CHECK(mesh.positions[2].x == 1.5f && mesh.positions[2].z == -0.25f);
+    const unsigned int expected[] = { 0, 1, 2,  0, 2, 3,  0, 2, 3,  0, 1, 2 };
+    for (int i = 0; i < 12; ++i)
+        CHECK(mesh.indices[i] == expected[i]);
+}
+
+static void testParallel()
+{
+    std::string text;
+    const int rows = 400;                                       /* a grid of (rows + 1)^2 vertices */
+    for (int y = 0; y <= rows; ++y)
+        for (int x = 0; x <= rows; ++x)
+            text += "v " + std::to_string(x) + " " + std::to_string(y) + " 0.5\n";
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < rows; ++x)
+        {
+            const int a = y * (rows + 1) + x + 1;
+            text += "f " + std::to_string(a) + " " + std::to_string(a + 1) + " " +
+                std::to_string(a + rows + 2) + " " + std::to_string(a + rows + 1) + "\n";
+        }
+    CHECK(writeText("mesh_grid.obj", text.c_str()));
+    TriangleMesh serial, parallel;
+    ThreadPool pool(4);
+    CHECK(loadObj(serial, "mesh_grid.obj"));
+    CHECK(loadObj(parallel, "mesh_grid.obj", &pool));
+    CHECK(serial.triangles() == size_t(2 * rows * rows));
+    CHECK(serial.indices == parallel.indices);
+    CHECK(serial.positions.size() == parallel.positions.size());
+}
+
+static void expectFailure(const char* text)
+{
+    CHECK(writeText("mesh_bad.obj", text));
+    TriangleMesh mesh;
+    const bool loaded = loadObj(mesh, "mesh_bad.obj");
+    CHECK(!loaded);
+    if (loaded) fprintf(stderr, "  for \"%s\"\n", text);
+}
+
+static void testMalformed()
+{
+    expectFailure("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n");     /* past the last vertex */
+    expectFailure("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n");     /* indices are 1 based */
+    expectFailure("v 0 0 0\nv 1 0 0\nv 0 1 0\nf -4 1 2\n");    /* before the first vertex */
+    expectFailure("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 x 2\n");
+    expectFailure("v 0 0\n");
+    expectFailure("v 0 zero 0\n");
+    TriangleMesh mesh;
+    CHECK(!loadObj(mesh, "mesh_missing.obj"));
+}
+
+int main()
+{
+    testLoad();
+    testParallel();
+    testMalformed();
+    return checkResult();
+}
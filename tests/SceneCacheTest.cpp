@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////
+/// Scene caches: a loaded cache rendering the frame the
+/// scene it was saved from renders, and truncated or
+/// corrupted caches failing to load or to validate rather
+/// than being traversed.
+////////////////////////////////////////////////////////////
+#include "Check.h"
+#include "Trace.h"
+#include "SceneGen.h"
+#include "SceneCache.h"
+#include <string.h>             /* memcmp */
+#include <string>
+#include <vector>
+
+static std::vector<char> readBytes(const char* path)
+{
+    std::vector<char> bytes;
+    FILE* file = fopen(path, "rb");
+    if (!file) return bytes;
+    char buffer[4096];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+    return bytes;
+}
+
+static bool writeBytes(const char* path, const char* bytes, const size_t size)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    const bool ok = fwrite(bytes, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+/* loading a cache into a fresh renderer and preparing it, as rtr --cache does */
+static bool loads(Renderer& r, const char* path)
+{
+    r.threads = 1;
+    std::shared_ptr<Scene> scene(new Scene);
+    if (!scene->load(path, r.cameras))
+        return false;
+    r.scene = scene;
+    return r.init() && !r.cameras.empty();
+}
+
+static void render(Renderer& r, Framebuffer& frame, const int size = 32)
+{
+    frame.resize(size, size);
+    r.capture(frame, 0, 3);
+}
+
+static bool sameFrames(const Framebuffer& a, const Framebuffer& b)
+{
+    return a.width() == b.width() && a.height() == b.height() &&
+        !memcmp(a.data(), b.data(), a.stride() * a.height());
+}
+
+static void testRoundTrip()
+{
+    SceneSpec spec;
+    spec.prims = 20;
+    spec.lights = 2;
+    Renderer generated, cached;
+    generated.threads = 2;
+    generateScene(generated, spec);
+    CHECK(generated.init());
+    CHECK(generated.scene->save("cache_round.cache", generated.cameras));
+    CHECK(loads(cached, "cache_round.cache"));
+    if (!cached.scene->cache) return;
+    CHECK(cached.cameras.size() == generated.cameras.size());
+    CHECK(cached.scene->point_lights.size() == 2 && cached.scene->objects.empty());
+    Framebuffer a, b;
+    render(generated, a);
+    render(cached, b);
+    CHECK(sameFrames(a, b));
+
+    Renderer again;                                 /* loading over a loaded scene replaces it */
+    CHECK(loads(again, "cache_round.cache"));
+    CHECK(again.scene->load("cache_round.cache", again.cameras) && again.init());
+    CHECK(again.scene->point_lights.size() == 2);
+    Framebuffer c;
+    render(again, c);
+    CHECK(sameFrames(a, c));
+}
+
+static void testTruncated(const std::vector<char>& bytes)
+{
+    /* the last array's padding may go without loss; any cut before it has to be noticed */
+    for (size_t length = 0; length + CACHE_LINE < bytes.size(); length += length < 256 ? 1 : 61)
+    {
+        CHECK(writeBytes("cache_cut.cache", bytes.data(), length));
+        Renderer r;
+        const bool loaded = loads(r, "cache_cut.cache");
+        CHECK(!loaded);
+        if (loaded) fprintf(stderr, "  cut to %zu of %zu bytes\n", length, bytes.size());
+    }
+}
+
+/* the cache with one byte xored by mask; true when it loads and validates */
+static bool accepts(const std::vector<char>& bytes, const size_t at, const unsigned char mask, Framebuffer& frame)
+{
+    std::vector<char> changed(bytes);
+    changed[at] = char(changed[at] ^ mask);
+    CHECK(writeBytes("cache_flip.cache", changed.data(), changed.size()));
+    Renderer r;
+    if (!loads(r, "cache_flip.cache"))
+        return false;
+    render(r, frame, 8);
+    return true;
+}
+
+static void testFlipped(const std::vector<char>& bytes)
+{
+    Framebuffer frame;
+    /* each array is a line of its length and element size, then its elements from the next line */
+    CHECK(!accepts(bytes, 0, 0x01, frame));                         /* header length */
+    CHECK(!accepts(bytes, CACHE_LINE, 0x20, frame));                /* magic */
+    CHECK(!accepts(bytes, CACHE_LINE + 8, 0x01, frame));            /* version */
+    CHECK(!accepts(bytes, 2 * CACHE_LINE + 7, 0x40, frame));        /* camera count past the end */
+    CHECK(!accepts(bytes, 2 * CACHE_LINE + 8, 0x01, frame));        /* camera size */
+    /* the first node's second child, in the array after the header, cameras, ambient and lights */
+    CacheReader in(bytes.data(), bytes.size());
+    CacheHeader header;
+    Vec3r ambient;
+    const Camera* cameras;
+    const PointLight* lights;
+    const BVH::Node* nodes = nullptr;
+    size_t count = 0;
+    CHECK(in.value(header) && in.get(cameras, count) && in.value(ambient) && in.get(lights, count) &&
+        in.get(nodes, count) && count > 1);
+    if (nodes && count > 1 && !nodes[0].count)
+    {
+        const size_t offset = (const char*)&nodes[0].offset - bytes.data();
+        CHECK(!accepts(bytes, offset, 0x01, frame));
+        CHECK(!accepts(bytes, offset + 3, 0x80, frame));
+    }
+    /* every other byte may hold a coordinate or a colour, so flipping it need only not crash */
+    for (size_t at = 0; at < bytes.size(); ++at)
+        accepts(bytes, at, 0xff, frame);
+}
+
+int main()
+{
+    testRoundTrip();
+    const std::vector<char> bytes = readBytes("cache_round.cache");
+    CHECK(bytes.size() > 4 * CACHE_LINE);
+    testTruncated(bytes);
+    testFlipped(bytes);
+    return checkResult();
+}
@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////
+/// Scene descriptions: what loadScene builds from a file,
+/// that saveScene writes what it reads back unchanged, in
+/// any locale, that numbers parse to the nearest double,
+/// and that malformed statements fail with their line.
+////////////////////////////////////////////////////////////
+#include "Check.h"
+#include "Trace.h"
+#include "SceneFile.h"
+#include "SceneGen.h"
+#include "TextParse.h"
+#include <string.h>             /* memcmp, strlen */
+#include <float.h>              /* DBL_MAX */
+#include <math.h>               /* HUGE_VAL */
+#include <locale.h>             /* setlocale */
+#include <string>
+#include <vector>
+
+static std::string readText(const char* path)
+{
+    std::string text;
+    FILE* file = fopen(path, "rb");
+    if (!file) return text;
+    char buffer[4096];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0;)
+        text.append(buffer, n);
+    fclose(file);
+    return text;
+}
+
+static void testLoad()
+{
+    CHECK(writeText("scene_load.scene",
+        "# comment\n"
+        "camera  0 0 500   0 0 0   1 0 0   0 1 0\n"
+        "ambient 0.1 0.2 0.3   # trailing comment\n"
+        "light   -500 -50 -400   0.4 0.4 0.4\r\n"
+        "material red ambient 1 0 0 diffuse 1 0 0 specular 0.9 exponent 30 reflect 0.4\n"
+        "\n"
+        "polygon red  -300 130 300   300 130 300   300 130 0\n"
+        "sphere red   -1.5e2 70 5E2  75\n"));
+    Renderer r;
+    std::string error;
+    CHECK(loadScene(r, "scene_load.scene", nullptr, &error));
+    CHECK(error.empty());
+    if (!r.scene) return;
+    const Scene& s = *r.scene;
+    CHECK(r.cameras.size() == 1);
+    CHECK(s.ambient.x == Real(0.1) && s.ambient.y == Real(0.2) && s.ambient.z == Real(0.3));
+    CHECK(s.point_lights.size() == 1);
+    CHECK(s.point_lights.size() == 1 && s.point_lights[0]->centre.x == -500);
+    CHECK(s.objects.size() == 2);
+    if (s.objects.size() != 2) return;
+    const TPolygon* poly = dynamic_cast<const TPolygon*>(s.objects[0]);
+    CHECK(poly && poly->vertices.size() == 4);                  /* closed by the loader */
+    const Sphere* sphere = dynamic_cast<const Sphere*>(s.objects[1]);
+    CHECK(sphere && sphere->centre.x == -150 && sphere->centre.z == 500 && sphere->radius == 75);
+    CHECK(sphere && sphere->material.reflect == Real(0.4) && sphere->material.exponent == 30);
+}
+
+static void testRoundTrip()
+{
+    SceneSpec spec;
+    spec.prims = 200;
+    spec.lights = 3;
+    spec.layout = SceneSpec::Clusters;
+    Renderer generated, loaded;
+    generateScene(generated, spec);
+    CHECK(saveScene(generated, "scene_first.scene"));
+    CHECK(loadScene(loaded, "scene_first.scene"));
+    CHECK(saveScene(loaded, "scene_second.scene"));
+    const std::string first = readText("scene_first.scene");
+    CHECK(!first.empty() && first == readText("scene_second.scene"));
+    if (!loaded.scene) return;
+    const std::vector<BaseObject*>& a = generated.scene->objects, &b = loaded.scene->objects;
+    CHECK(a.size() == b.size());
+    for (size_t i = 1; i < a.size() && i < b.size(); ++i)           /* spheres after the floor */
+    {
+        const Sphere* x = dynamic_cast<const Sphere*>(a[i]);
+        const Sphere* y = dynamic_cast<const Sphere*>(b[i]);
+        CHECK(x && y && x->centre.x == y->centre.x && x->centre.y == y->centre.y &&
+            x->centre.z == y->centre.z && x->radius == y->radius);
+        if (i > 1)                                                  /* loaded into one block */
+            CHECK(y == dynamic_cast<const Sphere*>(b[i - 1]) + 1);
+    }
+}
+
+static bool parsesTo(const char* text, const double expected)
+{
+    double v = -1;
+    const char* end = text + strlen(text);
+    const bool ok = parseNumber(text, end, v) == end && !memcmp(&v, &expected, sizeof(v));
+    if (!ok) fprintf(stderr, "  \"%s\" parsed to %.17g\n", text, v);
+    return ok;
+}
+
+static void testNumbers()
+{
+    CHECK(parsesTo("0.1", 0.1));
+    CHECK(parsesTo("-1.5e2", -150.0));
+    CHECK(parsesTo("9007199254740993", 9007199254740992.0));               /* halfway, to even */
+    CHECK(parsesTo("9007199254740995", 9007199254740996.0));
+    CHECK(parsesTo("9007199254740993.00000000000000000000001", 9007199254740994.0));
+    CHECK(parsesTo("0.1000000000000000055511151231257827021181583404541015625", 0.1));
+    CHECK(parsesTo("123456789012345678901234567890", 123456789012345678901234567890.0));
+    CHECK(parsesTo("2.2250738585072011e-308", 2.2250738585072011e-308));   /* largest subnormal */
+    CHECK(parsesTo("4.9406564584124654e-324", 4.9406564584124654e-324));   /* smallest */
+    CHECK(parsesTo("2.4703282292062327e-324", 0.0));                       /* just under half of it */
+    CHECK(parsesTo("2.4703282292062328e-324", 4.9406564584124654e-324));
+    CHECK(parsesTo("1.7976931348623158e308", DBL_MAX));
+    CHECK(parsesTo("1.7976931348623159e308", HUGE_VAL));
+    CHECK(parsesTo("1e-400", 0.0));
+    CHECK(parsesTo("-1e400", -HUGE_VAL));
+    CHECK(parsesTo("0.000000000000000000000000000001e30", 1.0));
+
+    /* doubles of every magnitude read back from the 17 digits printf writes */
+    unsigned long long state = 1;
+    int failures = 0;
+    for (int i = 0; i < 200000 && failures < 10; ++i)
+    {
+        unsigned long long bits = state += 0x9E3779B97F4A7C15ull;             /* SplitMix64 */
+        bits = (bits ^ (bits >> 30)) * 0xBF58476D1CE4E5B9ull;
+        bits = (bits ^ (bits >> 27)) * 0x94D049BB133111EBull;
+        bits ^= bits >> 31;
+        double x;
+        memcpy(&x, &bits, sizeof(x));
+        if (x != x || x - x != 0) continue;                                 /* NaN or infinite */
+        char text[64];
+        snprintf(text, sizeof(text), "%.17g", x);
+        if (!parsesTo(text, x)) ++failures;
+    }
+    CHECK(!failures);
+}
+
+/* saving and loading a generated scene with a decimal comma locale, if the system has one */
+static void testLocale()
+{
+    SceneSpec spec;
+    spec.prims = 50;
+    Renderer generated, loaded;
+    generateScene(generated, spec);
+    CHECK(saveScene(generated, "scene_c.scene"));
+    const char* locales[] = { "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "German_Germany.1252" };
+    const char* chosen = nullptr;
+    for (const char* name : locales)
+        if (!chosen && setlocale(LC_ALL, name)) chosen = name;
+    if (!chosen) return;
+    CHECK(saveScene(generated, "scene_locale.scene"));
+    CHECK(loadScene(loaded, "scene_c.scene"));
+    CHECK(saveScene(loaded, "scene_locale_again.scene"));
+    setlocale(LC_ALL, "C");
+    const std::string text = readText("scene_c.scene");
+    CHECK(!text.empty() && text == readText("scene_locale.scene") && text == readText("scene_locale_again.scene"));
+}
+
+/* loading text that has to fail, its message naming the line */
+static void expectFailure(const char* text, const char* line)
+{
+    CHECK(writeText("scene_bad.scene", text));
+    Renderer r;
+    std::string error;
+    const bool loaded = loadScene(r, "scene_bad.scene", nullptr, &error);
+    CHECK(!loaded);
+    CHECK(error.find(line) != std::string::npos);
+    if (loaded || error.find(line) == std::string::npos)
+        fprintf(stderr, "  for \"%s\": %s\n", text, error.c_str());
+}
+
+static void testMalformed()
+{
+    expectFailure("ambient 0.1 0.1\n", "line 1:");
+    expectFailure("\n\nambient 0.1 0.1 x\n", "line 3:");
+    expectFailure("sphere nothing 0 0 0 1\n", "line 1:");
+    expectFailure("material m\nsphere\n", "line 2:");
+    expectFailure("polygon\n", "line 1:");
+    expectFailure("material m\nsphere m 0 0 0\n", "line 2:");
+    expectFailure("material m\nsphere m 0 0 0 1 2\n", "line 2:");
+    expectFailure("material m\npolygon m 0 0 0 1 1 1\n", "line 2:");
+    expectFailure("teapot 1 2 3\n", "line 1:");
+    expectFailure("material m shiny 1\n", "line 1:");
+    expectFailure("material m\nmesh m missing.obj\n", "line 2:");
+    expectFailure("light 0 0 0 1 1 1e\n", "line 1:");
+    expectFailure("camera 0 0 500 0 0 0 1 0 0 0 1\n", "line 1:");
+    Renderer r;
+    std::string error;
+    CHECK(!loadScene(r, "scene_missing.scene", nullptr, &error) && !error.empty());
+}
+
+int main()
+{
+    testLoad();
+    testRoundTrip();
+    testNumbers();
+    testLocale();
+    testMalformed();
+    return checkResult();
+}